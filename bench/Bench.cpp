@@ -0,0 +1,331 @@
+#include "Entities.hpp"
+#include "Framebuffer.hpp"
+#include "Kernels.hpp"
+#include "Level.hpp"
+#include "Renderer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Result {
+    std::string name;
+    long iterations;
+    double nsPerIter;
+    long pixelsPerIter;
+};
+
+struct Bench {
+    Bench() : minTime(0.2), filter(nullptr) {}
+
+    // Runs fn until minTime has passed; pixels is the number of pixels one call touches.
+    template <typename F>
+    void run(const std::string& name, long pixels, F fn) {
+        if (filter && name.find(filter) == std::string::npos) {
+            return;
+        }
+        typedef std::chrono::steady_clock Clock;
+        fn();
+        long iterations = 0;
+        Clock::time_point start = Clock::now();
+        std::chrono::duration<double> elapsed(0);
+        for (long batch = 1; elapsed.count() < minTime; batch *= 2) {
+            for (long i = 0; i < batch; ++i) {
+                fn();
+            }
+            iterations += batch;
+            elapsed = Clock::now() - start;
+        }
+
+        Result r;
+        r.name = name;
+        r.iterations = iterations;
+        r.nsPerIter = elapsed.count() * 1e9 / iterations;
+        r.pixelsPerIter = pixels;
+        results.push_back(r);
+        printf("%-32s %12.1f ns %10.3f ns/px %10.1f Mpx/s\n", name.c_str(), r.nsPerIter,
+            r.nsPerIter / pixels, pixels * 1e3 / r.nsPerIter);
+    }
+
+    bool writeJson(const char* path) const {
+        FILE* fp = fopen(path, "w");
+        if (!fp) {
+            fprintf(stderr, "Failed to open %s\n", path);
+            return false;
+        }
+        fprintf(fp, "{\n  \"kernels\": \"%s\",\n  \"benchmarks\": [\n", kernels().name);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_iter\": %.3f, \"pixels_per_iter\": %ld, "
+                "\"ns_per_pixel\": %.6f, \"pixels_per_second\": %.1f}%s\n",
+                r.name.c_str(), r.iterations, r.nsPerIter, r.pixelsPerIter,
+                r.nsPerIter / r.pixelsPerIter, r.pixelsPerIter * 1e9 / r.nsPerIter, i + 1 < results.size() ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        return fclose(fp) == 0;
+    }
+
+    double minTime;
+    const char* filter;
+    std::vector<Result> results;
+};
+
+static long coverage(const DrawableBox& e) {
+    Span spans[MAX_SPANS];
+    long pixels = 0;
+    for (int y = e.ymin(); y <= e.ymax(); ++y) {
+        int n = e.getSpans(y, spans, MAX_SPANS);
+        if (n > MAX_SPANS) {
+            for (int x = e.xmin(); x <= e.xmax(); ++x) {
+                pixels += e.shouldDraw(Point(x, y));
+            }
+            continue;
+        }
+        for (int i = 0; i < n; ++i) {
+            pixels += spans[i].x1 - spans[i].x0 + 1;
+        }
+    }
+    return pixels;
+}
+
+// Up to 100 instances laid out on a grid that stays inside the framebuffer.
+template <typename T, typename Make>
+static std::vector<T> grid(const Framebuffer& fb, int rad, Make make) {
+    std::vector<T> v;
+    int step = 2 * rad + 2;
+    for (int y = rad; y + rad < fb.getHeight() && v.size() < 100; y += step) {
+        for (int x = rad; x + rad < fb.getWidth() && v.size() < 100; x += step) {
+            v.push_back(make(Point(x, y)));
+        }
+    }
+    return v;
+}
+
+template <typename T>
+static void drawables(Bench& bench, Framebuffer& fb, const char* kind, int rad, const std::vector<T>& v) {
+    long pixels = 0;
+    for (const T& e : v) {
+        pixels += coverage(e);
+    }
+    std::string suffix = std::string(kind) + "/r" + std::to_string(rad);
+    bench.run("draw/" + suffix, pixels, [&] {
+        for (const T& e : v) {
+            fb.draw(static_cast<const DrawableBox&>(e));
+        }
+    });
+    bench.run("batch/" + suffix, pixels, [&] { fb.drawBatch(v.data(), v.data() + v.size()); });
+}
+
+static void primitives(Bench& bench) {
+    Framebuffer fb(SCREEN_WIDTH, SCREEN_HEIGHT);
+    Level level(SCREEN_WIDTH, SCREEN_HEIGHT);
+    Palette palette;
+    level.fillPalette(palette);
+    palette.build();
+    fb.setPalette(&palette);
+    long pixels = (long)SCREEN_WIDTH * SCREEN_HEIGHT;
+    bench.run("clear/1080p", pixels, [&] { fb.clear(); });
+
+    const int radii[] = { 5, 35, 120 };
+    for (int rad : radii) {
+        drawables(bench, fb, "coin", rad, grid<Coin>(fb, rad, [&](const Point& p) { return Coin(p, rad); }));
+        drawables(bench, fb, "wall", rad, grid<Wall>(fb, rad, [&](const Point& p) {
+            return Wall(Point(p.x - rad, p.y - rad), Point(p.x + rad, p.y + rad));
+        }));
+        drawables(bench, fb, "pacman", rad, grid<Pacman>(fb, rad, [&](const Point& p) { return Pacman(p, rad); }));
+        drawables(bench, fb, "ghost", rad, grid<Ghost>(fb, rad, [&](const Point& p) {
+            return Ghost(p, Color3f(1.f, 0.341f, 0.016f), rad);
+        }));
+    }
+
+    Bitmap ghost(GHOST_BITMAP_PATH, GHOST_BITMAP_WIDTH, GHOST_BITMAP_HEIGHT);
+    const int samples = 256;
+    volatile float sink = 0.f;
+    bench.run("bitmap/sample", samples * samples, [&] {
+        float sum = 0.f;
+        for (int y = 0; y < samples; ++y) {
+            for (int x = 0; x < samples; ++x) {
+                sum += ghost.sample((float)x / samples, (float)y / samples).r;
+            }
+        }
+        sink = sink + sum;
+    });
+}
+
+// Coins scattered over the screen, as an entity store and as polymorphic objects.
+static void entities(Bench& bench) {
+    Framebuffer fb(SCREEN_WIDTH, SCREEN_HEIGHT);
+    Level level(SCREEN_WIDTH, SCREEN_HEIGHT);
+    Palette palette;
+    level.fillPalette(palette);
+    palette.build();
+    fb.setPalette(&palette);
+    const int counts[] = { 1000, 100000 };
+    for (int count : counts) {
+        Entities e;
+        std::vector<Coin> coins;
+        std::mt19937 rng(1);
+        for (int i = 0; i < count; ++i) {
+            int x = COIN_RAD + rng() % (SCREEN_WIDTH - 2 * COIN_RAD);
+            int y = COIN_RAD + rng() % (SCREEN_HEIGHT - 2 * COIN_RAD);
+            Point p(x, y);
+            e.add(entity_coin, toFixed(p), toFixed(COIN_RAD), COIN_COLOR);
+            coins.push_back(Coin(p));
+        }
+        long pixels = 0;
+        for (const Coin& c : coins) {
+            pixels += coverage(c);
+        }
+
+        std::string suffix = "/" + std::to_string(count);
+        std::vector<int> hits;
+        FixedPoint center = toFixed(Point(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2));
+        bench.run("entities/collide" + suffix, count, [&] {
+            hits.clear();
+            collideEntities(e, entity_coin, center, toFixed(PACMAN_RAD), hits);
+        });
+        bench.run("entities/draw" + suffix, pixels, [&] { drawEntities(fb, e, fb.getBounds()); });
+        bench.run("entities/virtual" + suffix, pixels, [&] {
+            for (const Coin& c : coins) {
+                fb.draw(static_cast<const DrawableBox&>(c));
+            }
+        });
+    }
+}
+
+static void kernelVariants(Bench& bench) {
+    const int count = SCREEN_WIDTH;
+    std::vector<Color4b> dst(count);
+    std::vector<Color4b> src(count, Color4b(1, 2, 3));
+    std::vector<uint8_t> mask(count);
+    std::vector<uint8_t> indices(count);
+    std::vector<Color4b> palette(256);
+    for (int i = 0; i < count; ++i) {
+        mask[i] = i % 3 ? 255 : 0;
+        indices[i] = i * 7;
+    }
+
+    const Kernels* variants[] = { scalarKernels(), sse2Kernels(), avx2Kernels(), avx512Kernels() };
+    for (const Kernels* k : variants) {
+        if (!k) {
+            continue;
+        }
+        std::string prefix = std::string("kernel/") + k->name;
+        bench.run(prefix + "/fill", count, [&] { k->fillSpan(dst.data(), count, Color4b(9, 9, 9)); });
+        bench.run(prefix + "/blit", count, [&] { k->maskedBlit(dst.data(), src.data(), mask.data(), count); });
+        bench.run(prefix + "/expand", count, [&] {
+            k->expandIndices(dst.data(), indices.data(), palette.data(), count);
+        });
+    }
+}
+
+template <typename Pixel, typename Layout>
+static void layoutFrame(Bench& bench, const char* layout, const char* res, int width, int height) {
+    BasicFramebuffer<Pixel, Layout> fb(width, height);
+    std::vector<Color4b> linear(width * height);
+    Level level(width, height);
+    Palette palette;
+    level.fillPalette(palette);
+    palette.build();
+    fb.setPalette(&palette);
+    long pixels = (long)width * height;
+    std::string suffix = std::string(layout) + "/" + res;
+
+    bench.run("layout/clear/" + suffix, pixels, [&] { fb.clear(); });
+    bench.run("layout/frame/" + suffix, pixels, [&] {
+        fb.clear();
+        drawEntities(fb, level.coins, fb.getBounds());
+        fb.drawBatch(level.walls.data(), level.walls.data() + level.walls.size());
+        fb.draw(level.pacman);
+        fb.draw(level.redGhost);
+        fb.draw(level.greenGhost);
+        fb.draw(level.blueGhost);
+    });
+    bench.run("layout/present/" + suffix, pixels, [&] { fb.readColors(linear.data(), fb.getBounds()); });
+}
+
+static void frames(Bench& bench) {
+    const RenderMode modes[] = { render_retained, render_immediate, render_tiled };
+    const char* names[] = { "retained", "immediate", "tiled" };
+    for (int i = 0; i < 3; ++i) {
+        Options opts;
+        opts.mode = modes[i];
+        Framebuffer fb(SCREEN_WIDTH, SCREEN_HEIGHT);
+        Level level(SCREEN_WIDTH, SCREEN_HEIGHT);
+        Renderer renderer(opts, fb, level);
+        renderer.render();
+        fb.clearDirty();
+
+        // Pacman steps back and forth, so that retained mode has something to redraw.
+        int dx = 1;
+        auto step = [&] {
+            renderer.getScene().move(&level.pacman, dx, 0);
+            dx = -dx;
+        };
+        long pixels = (long)SCREEN_WIDTH * SCREEN_HEIGHT;
+        if (modes[i] == render_retained) {
+            step();
+            pixels = 0;
+            for (const Box& r : fb.getDirty()) {
+                pixels += (long)(r.width() + 1) * (r.height() + 1);
+            }
+            renderer.render();
+            fb.clearDirty();
+        }
+        bench.run(std::string("frame/") + names[i], pixels, [&] {
+            step();
+            renderer.render();
+            fb.clearDirty();
+        });
+    }
+
+    layoutFrame<Color4b, LinearLayout>(bench, "linear", "1080p", 1920, 1080);
+    layoutFrame<Color4b, TiledLayout<8>>(bench, "tiled8", "1080p", 1920, 1080);
+    layoutFrame<Color4b, TiledLayout<16>>(bench, "tiled16", "1080p", 1920, 1080);
+    layoutFrame<uint8_t, LinearLayout>(bench, "indexed", "1080p", 1920, 1080);
+    layoutFrame<Color4b, LinearLayout>(bench, "linear", "4K", 3840, 2160);
+    layoutFrame<Color4b, TiledLayout<8>>(bench, "tiled8", "4K", 3840, 2160);
+    layoutFrame<Color4b, TiledLayout<16>>(bench, "tiled16", "4K", 3840, 2160);
+    layoutFrame<uint8_t, LinearLayout>(bench, "indexed", "4K", 3840, 2160);
+}
+
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --json FILE      write the results to FILE\n"
+        "  --filter TEXT    only run benchmarks whose name contains TEXT\n"
+        "  --min-time SEC   run each benchmark for at least SEC seconds (default: 0.2)\n",
+        prog);
+}
+
+int main(int argc, char** argv) {
+    Bench bench;
+    const char* json = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            bench.filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            bench.minTime = atof(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    printf("kernels: %s\n", kernels().name);
+    primitives(bench);
+    entities(bench);
+    kernelVariants(bench);
+    frames(bench);
+
+    if (json && !bench.writeJson(json)) {
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "Layout.hpp"
+
+#include <cstdint>
+
 struct Color3f {
     Color3f() = default;
     Color3f(float r, float g, float b) : r(r), g(g), b(b) {}
@@ -11,16 +15,60 @@ struct Color3f {
     float b;
 };
 
-struct Bitmap {
-    Bitmap(int width, int height);
-    Bitmap(const char* path, int width, int height);
-    ~Bitmap();
+// Packed 8-bit RGBA, laid out as GL_RGBA/GL_UNSIGNED_BYTE expects.
+struct Color4b {
+    Color4b() = default;
+    Color4b(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) : r(r), g(g), b(b), a(a) {}
+
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+template <typename Pixel>
+Pixel convertColor(Color3f col);
+
+template <>
+inline Color3f convertColor<Color3f>(Color3f col) {
+    return col;
+}
 
-    void draw(int x, int y, Color3f col);
-    Color3f sample(int x, int y) const;
-    Color3f sample(float u, float v) const;
+inline uint8_t toUnorm8(float v) {
+    if (v <= 0.f) {
+        return 0;
+    }
+    if (v >= 1.f) {
+        return 255;
+    }
+    return v * 255.f + 0.5f;
+}
+
+template <>
+inline Color4b convertColor<Color4b>(Color3f col) {
+    return Color4b(toUnorm8(col.r), toUnorm8(col.g), toUnorm8(col.b));
+}
+
+template <typename Pixel, typename Layout = LinearLayout>
+struct BasicBitmap {
+    BasicBitmap(int width, int height);
+    // Reads width * height raw pixels from the file.
+    BasicBitmap(const char* path, int width, int height);
+    ~BasicBitmap();
+
+    void draw(int x, int y, Pixel col);
+    void fill(int x0, int x1, int y, Pixel col);
+    Pixel sample(int x, int y) const;
+    Pixel sample(float u, float v) const;
+
+    // Pixels of row y from x up to Layout::runEnd(x) are contiguous from here on.
+    Pixel* at(int x, int y) { return data + Layout::offset(x, y, width); }
+    const Pixel* at(int x, int y) const { return data + Layout::offset(x, y, width); }
 
     int width;
     int height;
-    Color3f* data;
+    Pixel* data;
 };
+
+typedef BasicBitmap<Color3f> Bitmap;
+typedef BasicBitmap<Color4b> Bitmap4b;
@@ -4,4 +4,28 @@ const int COIN_RAD = 5;
 const int PACMAN_RAD = 35;
 const float PACMAN_ANGLE = 0.9f;
 const int GHOST_RAD = 35;
+const float GHOST_ALPHA_MIN = 0.05f;
 const int LINE_RAD = 2;
+const int MAX_SPANS = 16;
+const int TILE_SIZE = 64;
+const int SCREEN_WIDTH = 1920;
+const int SCREEN_HEIGHT = 1080;
+const int HEADLESS_FRAMES = 100;
+const int PROFILER_FRAMES = 120;
+const int TRACE_EVENTS = 1 << 16;
+const int UPLOAD_BUFFERS = 3;
+const int UPLOAD_RECT_COST = 4096;
+const float UPLOAD_FULL_RATIO = 0.5f;
+const int PALETTE_RAMP = 64;
+const int PACER_SPIN_US = 2000;
+const float RES_MIN_SCALE = 0.25f;
+const float RES_STEP = 0.05f;
+const int RES_INTERVAL = 30;
+const float RES_HEADROOM = 0.8f;
+const float IDLE_TIMEOUT = 0.1f;
+const int SIM_HZ = 120;
+const int SIM_MAX_CATCHUP = 12;
+const int PACMAN_SPEED = 3;
+const int GHOST_SPEED = 2;
+const int GHOST_TURN_TICKS = 120;
+const int PIPELINE_MAX_FRAMES = 4;
@@ -2,9 +2,13 @@
 
 #include "Config.hpp"
 #include "Bitmap.hpp"
+#include "Fixed.hpp"
+#include "Span.hpp"
+#include "Sprite.hpp"
 
 #include <algorithm>
 #include <cmath>
+#include <deque>
 
 struct Point {
     Point() {}
@@ -33,6 +37,26 @@ struct Box {
         return p.x >= pmin.x && p.x <= pmax.x && p.y >= pmin.y && p.y <= pmax.y;
     }
 
+    bool overlaps(const Box& b) const {
+        return pmin.x <= b.pmax.x && b.pmin.x <= pmax.x && pmin.y <= b.pmax.y && b.pmin.y <= pmax.y;
+    }
+
+    Box unite(const Box& b) const {
+        return Box(Point(std::min(pmin.x, b.pmin.x), std::min(pmin.y, b.pmin.y)),
+            Point(std::max(pmax.x, b.pmax.x), std::max(pmax.y, b.pmax.y)));
+    }
+
+    Box intersect(const Box& b) const {
+        Box res(*this);
+        res.pmin.x = std::max(pmin.x, b.pmin.x);
+        res.pmin.y = std::max(pmin.y, b.pmin.y);
+        res.pmax.x = std::min(pmax.x, b.pmax.x);
+        res.pmax.y = std::min(pmax.y, b.pmax.y);
+        return res;
+    }
+
+    bool empty() const { return pmin.x > pmax.x || pmin.y > pmax.y; }
+
     int xmin() const { return pmin.x; }
     int xmax() const { return pmax.x; }
     int ymin() const { return pmin.y; }
@@ -40,11 +64,46 @@ struct Box {
 
     int width() const { return pmax.x - pmin.x; }
     int height() const { return pmax.y - pmin.y; }
+    Point center() const { return Point((pmin.x + pmax.x) / 2, (pmin.y + pmax.y) / 2); }
 
     Point pmin;
     Point pmax;
 };
 
+inline FixedPoint toFixed(const Point& p) {
+    return FixedPoint(toFixed(p.x), toFixed(p.y));
+}
+
+inline int64_t isqrt(int64_t v) {
+    int64_t r = (int64_t)std::sqrt((double)v);
+    while (r * r > v) {
+        --r;
+    }
+    while ((r + 1) * (r + 1) <= v) {
+        ++r;
+    }
+    return r;
+}
+
+// Pixels of row y whose centers are inside the circle. Squared distances of 24.8 values
+// need 48 bits, the rest is integer math.
+inline bool circleSpan(const FixedPoint& center, Fixed rad, int y, Span& span) {
+    int64_t dy = (int64_t)toFixed(y) - center.y;
+    int64_t rem = (int64_t)rad * rad - dy * dy;
+    if (rem < 0) {
+        return false;
+    }
+    Fixed half = (Fixed)isqrt(rem);
+    span = Span(ceilFixed(center.x - half), floorFixed(center.x + half));
+    return span.x0 <= span.x1;
+}
+
+// Pixels that a circle may cover.
+inline Box circleBounds(const FixedPoint& center, Fixed rad) {
+    return Box(Point(floorFixed(center.x - rad), floorFixed(center.y - rad)),
+        Point(ceilFixed(center.x + rad), ceilFixed(center.y + rad)));
+}
+
 struct DrawableBox : public Box {
     DrawableBox(const Box& b) : Box(b) {}
     DrawableBox(const Point& p, int rad) : Box(p, rad) {}
@@ -52,28 +111,99 @@ struct DrawableBox : public Box {
 
     virtual bool shouldDraw(const Point& p) const = 0;
     virtual Color3f getColor(const Point& p) const = 0;
+
+    // Writes the covered [x0, x1] runs of row y, left to right, and returns their count.
+    // A count above maxSpans means that only the first maxSpans runs were written, and
+    // the row has to be drawn pixel by pixel through shouldDraw instead.
+    virtual int getSpans(int y, Span* spans, int maxSpans) const = 0;
+    // Solid elements have the same color on every covered pixel.
+    virtual bool isSolid() const { return false; }
+    // Colors of row y starting at xmin(), for elements that can be blitted, or null.
+    virtual const Color3f* getRow(int) const { return nullptr; }
+    // Packed colors and coverage of row y starting at xmin(), for a masked blit.
+    virtual bool getMaskedRow(int, const Color4b*&, const uint8_t*&) const { return false; }
+
+    virtual void moveBy(int dx, int dy) {
+        pmin.x += dx;
+        pmin.y += dy;
+        pmax.x += dx;
+        pmax.y += dy;
+    }
+
+    // Center with sub-pixel precision. Elements without one snap to the nearest pixel.
+    virtual FixedPoint getPosition() const {
+        return toFixed(center());
+    }
+
+    virtual void setPosition(const FixedPoint& p) {
+        Point c = center();
+        moveBy(roundFixed(p.x) - c.x, roundFixed(p.y) - c.y);
+    }
+
+protected:
+    void setBounds(const Box& b) {
+        pmin = b.pmin;
+        pmax = b.pmax;
+    }
 };
 
-struct Coin : public DrawableBox {
-    Coin(const Point& pos) : DrawableBox(pos, COIN_RAD), pos(pos)  {
+// Concrete drawables are final so that Framebuffer::drawBatch can inline their
+// span and color queries. Each one also states, for the whole type:
+//   solid        - every covered pixel of an instance has the same color;
+//   uniformColor - all instances share that color, so a batch fetches it once.
+
+
+const Color3f COIN_COLOR(0.965f, 0.733f, 0.686f);
+
+struct Coin final : public DrawableBox {
+    static constexpr bool solid = true;
+    static constexpr bool uniformColor = true;
+
+    Coin(const Point& pos, int rad = COIN_RAD) : DrawableBox(pos, rad), pos(toFixed(pos)), rad(toFixed(rad)) {
     }
 
     bool shouldDraw(const Point& p) const override {
-        int dx = p.x - pos.x;
-        int dy = p.y - pos.y;
-        int dist2 = dx * dx + dy * dy;
-        return dist2 <= COIN_RAD * COIN_RAD;
+        int64_t dx = (int64_t)toFixed(p.x) - pos.x;
+        int64_t dy = (int64_t)toFixed(p.y) - pos.y;
+        return dx * dx + dy * dy <= (int64_t)rad * rad;
     }
 
     Color3f getColor(const Point&) const override {
-        return Color3f(0.965f, 0.733f, 0.686f);
+        return COIN_COLOR;
+    }
+
+    int getSpans(int y, Span* spans, int) const override {
+        return circleSpan(pos, rad, y, spans[0]) ? 1 : 0;
+    }
+
+    bool isSolid() const override {
+        return solid;
+    }
+
+    void moveBy(int dx, int dy) override {
+        DrawableBox::moveBy(dx, dy);
+        pos.x += toFixed(dx);
+        pos.y += toFixed(dy);
+    }
+
+    FixedPoint getPosition() const override {
+        return pos;
+    }
+
+    void setPosition(const FixedPoint& p) override {
+        pos = p;
+        setBounds(circleBounds(pos, rad));
     }
 
 private:
-    Point pos;
+    FixedPoint pos;
+    Fixed rad;
 };
 
-struct Wall : public DrawableBox {
+struct Wall final : public DrawableBox {
+    static constexpr bool solid = true;
+    static constexpr bool uniformColor = true;
+
     Wall(const Point& p1, const Point& p2) : DrawableBox(p1, p2) {}
 
     bool shouldDraw(const Point&) const override {
@@ -83,82 +213,253 @@ struct Wall : public DrawableBox {
     Color3f getColor(const Point&) const override {
         return Color3f(0.122f, 0.153f, 0.824f);
     }
+
+    int getSpans(int y, Span* spans, int) const override {
+        if (y < ymin() || y > ymax()) {
+            return 0;
+        }
+        spans[0] = Span(xmin(), xmax());
+        return 1;
+    }
+
+    bool isSolid() const override {
+        return solid;
+    }
 };
 
 enum Direction {
     dir_left, dir_right, dir_up, dir_down
 };
 
-struct Pacman : public DrawableBox {
-    Pacman(const Point& pos) : DrawableBox(pos, PACMAN_RAD) {
-        mouth = pos;
+struct Pacman final : public DrawableBox {
+    static constexpr bool solid = true;
+    static constexpr bool uniformColor = true;
+
+    Pacman(const Point& pos, int rad = PACMAN_RAD) : DrawableBox(pos, rad), rad(toFixed(rad)) {
+        mouth = toFixed(pos);
         dir = dir_right;
     }
 
     bool shouldDraw(const Point& p) const override {
-        int dx = p.x - mouth.x;
-        int dy = p.y - mouth.y;
-        int dist2 = dx * dx + dy * dy;
-        if (dist2 > PACMAN_RAD * PACMAN_RAD) {
+        int64_t dx = (int64_t)toFixed(p.x) - mouth.x;
+        int64_t dy = (int64_t)toFixed(p.y) - mouth.y;
+        if (dx * dx + dy * dy > (int64_t)rad * rad) {
             return false;
         }
-
-        float dist = sqrt(dist2);
-        float cos = 0.f;
         switch (dir) {
             case dir_right:
-                cos = dx / dist;
-                break;
+                return !inMouth(dx, dy);
             case dir_up:
-                cos = dy / dist;
-                break;
+                return !inMouth(dy, dx);
             case dir_left:
-                cos = -dx / dist;
-                break;
+                return !inMouth(-dx, dy);
             case dir_down:
-                cos = -dy / dist;
-                break;
+                return !inMouth(-dy, dx);
         }
-        return cos < PACMAN_ANGLE;
+        return true;
     }
 
     Color3f getColor(const Point&) const override {
         return Color3f(1.f, 0.937f, 0.f);
     }
 
+    int getSpans(int y, Span* spans, int maxSpans) const override {
+        Span row;
+        if (!circleSpan(mouth, rad, y, row)) {
+            return 0;
+        }
+        int64_t dy = (int64_t)toFixed(y) - mouth.y;
+        switch (dir) {
+            case dir_right:
+                return clipSpan(row, ceilFixed(mouth.x + (Fixed)mouthStart(dy)), row.x1, spans, maxSpans);
+            case dir_left:
+                return clipSpan(row, row.x0, floorFixed(mouth.x - (Fixed)mouthStart(dy)), spans, maxSpans);
+            case dir_up:
+                return clipMouth(row, mouthHalfWidth(dy), spans, maxSpans);
+            case dir_down:
+                return clipMouth(row, mouthHalfWidth(-dy), spans, maxSpans);
+        }
+        return 0;
+    }
+
+    bool isSolid() const override {
+        return solid;
+    }
+
+    void moveBy(int dx, int dy) override {
+        DrawableBox::moveBy(dx, dy);
+        mouth.x += toFixed(dx);
+        mouth.y += toFixed(dy);
+    }
+
+    FixedPoint getPosition() const override {
+        return mouth;
+    }
+
+    void setPosition(const FixedPoint& p) override {
+        mouth = p;
+        setBounds(circleBounds(mouth, rad));
+    }
+
+    Direction getDirection() const {
+        return dir;
+    }
+
+    void setDirection(Direction d) {
+        dir = d;
+    }
+
 private:
-    Point mouth;
+    // The point is cut out when cos(angle to dir) >= PACMAN_ANGLE, where 'along' is the offset
+    // in the facing direction and 'across' the perpendicular one, both in fixed-point units.
+    // Squaring both sides leaves A * along^2 >= B * across^2 with A and B as 16 bit fractions.
+    static bool inMouth(int64_t along, int64_t across) {
+        if (along == 0 && across == 0) {
+            return true;
+        }
+        return along > 0 && mouthAlong() * along * along >= mouthAcross() * across * across;
+    }
+
+    static int64_t mouthAlong() {
+        return (int64_t)((1.f - PACMAN_ANGLE * PACMAN_ANGLE) * 65536.f + 0.5f);
+    }
+
+    static int64_t mouthAcross() {
+        return (int64_t)(PACMAN_ANGLE * PACMAN_ANGLE * 65536.f + 0.5f);
+    }
+
+    // Smallest 'along' offset that is cut out on a row 'across' away from the mouth.
+    static int64_t mouthStart(int64_t across) {
+        int64_t along = isqrt(mouthAcross() * across * across / mouthAlong());
+        while (along > 0 && inMouth(along - 1, across)) {
+            --along;
+        }
+        while (!inMouth(along, across)) {
+            ++along;
+        }
+        return along;
+    }
+
+    // Largest 'across' offset that is cut out on a row 'along' away from the mouth, or -1.
+    static int64_t mouthHalfWidth(int64_t along) {
+        if (!inMouth(along, 0)) {
+            return -1;
+        }
+        int64_t across = isqrt(mouthAlong() * along * along / mouthAcross());
+        while (across > 0 && !inMouth(along, across)) {
+            --across;
+        }
+        while (inMouth(along, across + 1)) {
+            ++across;
+        }
+        return across;
+    }
+
+    // Emits 'row' with the pixels within 'half' of the mouth column removed.
+    int clipMouth(const Span& row, int64_t half, Span* spans, int maxSpans) const {
+        if (half < 0) {
+            spans[0] = row;
+            return 1;
+        }
+        return clipSpan(row, ceilFixed(mouth.x - (Fixed)half), floorFixed(mouth.x + (Fixed)half), spans, maxSpans);
+    }
+
+    // Emits 'row' with the columns [cut0, cut1] removed.
+    static int clipSpan(const Span& row, int cut0, int cut1, Span* spans, int maxSpans) {
+        if (cut0 > cut1) {
+            spans[0] = row;
+            return 1;
+        }
+        int n = 0;
+        if (row.x0 < cut0) {
+            spans[n++] = Span(row.x0, std::min(row.x1, cut0 - 1));
+        }
+        if (cut1 < row.x1 && n < maxSpans) {
+            spans[n++] = Span(std::max(row.x0, cut1 + 1), row.x1);
+        }
+        return n;
+    }
+
+    FixedPoint mouth;
     Direction dir;
+    Fixed rad;
 };
 
-struct Ghost : public DrawableBox {
+struct Ghost final : public DrawableBox {
+    static constexpr bool solid = false;
+    static constexpr bool uniformColor = false;
+
     struct Singleton {
-        static const Bitmap& get() {
+        // Not thread safe, sprites are only created while constructing ghosts.
+        static Sprite& get(int rad) {
             static Bitmap ghost(GHOST_BITMAP_PATH, GHOST_BITMAP_WIDTH, GHOST_BITMAP_HEIGHT);
-            return ghost;
+            static std::deque<Sprite> sprites;
+            int size = 2 * rad + 1;
+            for (Sprite& s : sprites) {
+                if (s.width == size) {
+                    return s;
+                }
+            }
+            sprites.emplace_back(ghost, size, size, GHOST_ALPHA_MIN);
+            return sprites.back();
         }
     };
 
-    Ghost(const Point& pos, Color3f color) : DrawableBox(pos, GHOST_RAD), color(color) {}
+    Ghost(const Point& pos, Color3f color, int rad = GHOST_RAD) :
+        DrawableBox(pos, rad), sprite(&Singleton::get(rad)), tint(&Singleton::get(rad).getTint(color)) {}
 
     Color3f getColor(const Point& p) const override {
         if (inside(p)) {
-            int xoff = p.x - pmin.x;
-            int yoff = p.y - pmin.y;
-            float u = (float)xoff / width();
-            float v = (float)yoff / height();
-            float alpha = Singleton::get().sample(u, v).intensity();
-            return Color3f(color.r * alpha, color.g * alpha, color.b * alpha);
-            
+            return getRow(p.y)[p.x - pmin.x];
         }
         return Color3f(0.f, 0.f, 0.f);
     }
 
     bool shouldDraw(const Point& p) const override {
-        float alpha = getColor(p).intensity();
-        return alpha > 0.05f;
+        if (!inside(p)) {
+            return false;
+        }
+        int row = p.y - pmin.y;
+        int xoff = p.x - pmin.x;
+        for (int i = tint->rowStart[row]; i < tint->rowStart[row + 1]; ++i) {
+            if (xoff >= tint->spans[i].x0 && xoff <= tint->spans[i].x1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int getSpans(int y, Span* spans, int maxSpans) const override {
+        if (y < ymin() || y > ymax()) {
+            return 0;
+        }
+        int row = y - pmin.y;
+        int first = tint->rowStart[row];
+        int count = tint->rowStart[row + 1] - first;
+        int n = std::min(count, maxSpans);
+        for (int i = 0; i < n; ++i) {
+            const Span& s = tint->spans[first + i];
+            spans[i] = Span(pmin.x + s.x0, pmin.x + s.x1);
+        }
+        return count;
+    }
+
+    const Color3f* getRow(int y) const override {
+        return &tint->pixels[(y - pmin.y) * sprite->width];
+    }
+
+    bool getMaskedRow(int y, const Color4b*& pixels, const uint8_t*& mask) const override {
+        int off = (y - pmin.y) * sprite->width;
+        pixels = &tint->packed[off];
+        mask = &tint->covered[off];
+        return true;
+    }
+
+    Color3f getTintColor() const {
+        return tint->color;
     }
 
 private:
-    Color3f color;
+    const Sprite* sprite;
+    const Sprite::Tint* tint;
 };
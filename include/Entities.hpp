@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Drawable.hpp"
+#include "Framebuffer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+enum EntityType : uint8_t {
+    entity_coin
+};
+
+// Circular entities as parallel arrays indexed by entity id. Systems walk the components
+// they need linearly instead of visiting DrawableBox objects through their vtables.
+// Positions and radii are 24.8 fixed point.
+// Hidden entities keep their id, but are neither collided with nor drawn.
+struct Entities {
+    // Returns the id of the new entity, which starts visible.
+    int add(EntityType type, const FixedPoint& pos, Fixed rad, Color3f col);
+    int size() const;
+    // Pixels that entity id may cover.
+    Box getBounds(int id) const;
+
+    std::vector<Fixed> x;
+    std::vector<Fixed> y;
+    std::vector<Fixed> rad;
+    std::vector<Color3f> color;
+    std::vector<uint8_t> type;
+    std::vector<uint8_t> visible;
+};
+
+// Appends the ids of the entities of the given type whose circle touches the one at center.
+void collideEntities(const Entities& entities, EntityType type, const FixedPoint& center, Fixed rad,
+    std::vector<int>& hits);
+
+// Visible entity ids sorted into TILE_SIZE squares of a width x height area, by the
+// squares their bounds overlap. Squares are numbered row by row.
+struct EntityBins {
+    EntityBins() : tilesX(0), tilesY(0) {}
+
+    void build(const Entities& entities, int width, int height);
+    Box getTileBounds(int tile) const;
+
+    int tilesX;
+    int tilesY;
+    std::vector<std::vector<int>> bins;
+};
+
+// Draws entity id as a solid circle with the same coverage as a Coin there, clipped to
+// bounds, which has to lie inside the framebuffer.
+template <typename Pixel, typename Layout>
+void drawEntity(BasicFramebuffer<Pixel, Layout>& fb, const Entities& entities, int id, const Box& bounds) {
+    Box box = entities.getBounds(id).intersect(bounds);
+    if (box.empty()) {
+        return;
+    }
+    FixedPoint center(entities.x[id], entities.y[id]);
+    Pixel px = toPixel<Pixel>(entities.color[id], fb.getPalette());
+    Span row;
+    for (int y = box.ymin(); y <= box.ymax(); ++y) {
+        if (circleSpan(center, entities.rad[id], y, row)) {
+            fb.fillSpan(y, Span(std::max(row.x0, box.xmin()), std::min(row.x1, box.xmax())), px);
+        }
+    }
+}
+
+// Draws every visible entity.
+template <typename Pixel, typename Layout>
+void drawEntities(BasicFramebuffer<Pixel, Layout>& fb, const Entities& entities, const Box& clip) {
+    Box bounds = clip.intersect(fb.getBounds());
+    int count = entities.size();
+    for (int i = 0; i < count; ++i) {
+        if (entities.visible[i]) {
+            drawEntity(fb, entities, i, bounds);
+        }
+    }
+}
+
+// Draws the visible entities among ids, such as one bin of EntityBins.
+template <typename Pixel, typename Layout>
+void drawEntities(BasicFramebuffer<Pixel, Layout>& fb, const Entities& entities, const std::vector<int>& ids,
+    const Box& clip) {
+    Box bounds = clip.intersect(fb.getBounds());
+    for (int i : ids) {
+        if (entities.visible[i]) {
+            drawEntity(fb, entities, i, bounds);
+        }
+    }
+}
+
+// Draws the visible entities inside clip, looking only at the bins it overlaps. Each bin
+// only draws within its own square, so no pixel is filled twice.
+template <typename Pixel, typename Layout>
+void drawEntities(BasicFramebuffer<Pixel, Layout>& fb, const Entities& entities, const EntityBins& bins,
+    const Box& clip) {
+    Box bounds = clip.intersect(fb.getBounds());
+    if (bounds.empty()) {
+        return;
+    }
+    int tx1 = std::min(bounds.xmax() / TILE_SIZE, bins.tilesX - 1);
+    int ty1 = std::min(bounds.ymax() / TILE_SIZE, bins.tilesY - 1);
+    for (int ty = bounds.ymin() / TILE_SIZE; ty <= ty1; ++ty) {
+        for (int tx = bounds.xmin() / TILE_SIZE; tx <= tx1; ++tx) {
+            int tile = ty * bins.tilesX + tx;
+            drawEntities(fb, entities, bins.bins[tile], bins.getTileBounds(tile).intersect(bounds));
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// 24.8 fixed-point coordinate. Pixel x is x << FIXED_SHIFT, which stands for the center
+// of that pixel, so whole values behave exactly like the integer coordinates.
+typedef int32_t Fixed;
+
+const int FIXED_SHIFT = 8;
+const Fixed FIXED_ONE = 1 << FIXED_SHIFT;
+
+inline Fixed toFixed(int v) {
+    return v * FIXED_ONE;
+}
+
+inline Fixed toFixed(float v) {
+    return (Fixed)std::lround(v * FIXED_ONE);
+}
+
+// Pixel at or before v, and at or after it. Shifts round towards negative infinity.
+inline int floorFixed(Fixed v) {
+    return v >> FIXED_SHIFT;
+}
+
+inline int ceilFixed(Fixed v) {
+    return (v + FIXED_ONE - 1) >> FIXED_SHIFT;
+}
+
+inline int roundFixed(Fixed v) {
+    return (v + FIXED_ONE / 2) >> FIXED_SHIFT;
+}
+
+struct FixedPoint {
+    FixedPoint() {}
+    FixedPoint(Fixed x, Fixed y) : x(x), y(y) {}
+
+    bool operator==(const FixedPoint& p) const { return x == p.x && y == p.y; }
+    bool operator!=(const FixedPoint& p) const { return !(*this == p); }
+
+    Fixed x;
+    Fixed y;
+};
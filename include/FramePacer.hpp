@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Options.hpp"
+
+#include <chrono>
+
+// Frame pacing for the main loop. Swap-interval modes are set up by the window and only
+// measured here; pacing_limit holds frames to a fixed rate itself by sleeping until
+// PACER_SPIN_US before the deadline and spinning the rest, since sleeps overshoot.
+struct FramePacer {
+    typedef std::chrono::steady_clock Clock;
+
+    FramePacer(PacingMode mode, int fps);
+
+    // Call once per frame, after presenting. Waits for the next frame slot when limiting
+    // and records the interval since the previous call.
+    void endFrame();
+
+    // Mean frame interval and its standard deviation (the jitter), in milliseconds.
+    double meanInterval() const;
+    double jitter() const;
+    void print() const;
+
+private:
+    void waitUntil(Clock::time_point deadline) const;
+
+    PacingMode mode;
+    Clock::duration period;
+    Clock::time_point deadline;
+    Clock::time_point last;
+    bool started;
+
+    long count;
+    double mean;
+    double m2;
+    double minInterval;
+    double maxInterval;
+};
+
+const char* getPacingName(PacingMode mode);
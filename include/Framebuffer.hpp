@@ -1,17 +1,204 @@
 #pragma once
 
 #include "Drawable.hpp"
+#include "Kernels.hpp"
+#include "Palette.hpp"
 
-struct Framebuffer {
-    Framebuffer(int width, int height);
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+// Converts a drawable color to the stored format. uint8_t pixels are indices into the
+// framebuffer's palette.
+template <typename Pixel>
+inline Pixel toPixel(Color3f col, const Palette*) {
+    return convertColor<Pixel>(col);
+}
+
+template <>
+inline uint8_t toPixel<uint8_t>(Color3f col, const Palette* palette) {
+    return palette->lookup(convertColor<Color4b>(col));
+}
+
+// Rasterization target, parameterized on the pixel format it stores. Drawables produce
+// Color3f, which is converted to Pixel once per solid run or once per blitted pixel.
+template <typename Pixel, typename Layout = LinearLayout>
+struct BasicFramebuffer {
+    static constexpr bool linear = Layout::linear;
+    static constexpr bool indexed = std::is_same<Pixel, uint8_t>::value;
+
+    BasicFramebuffer(int width, int height);
+
+    // Indexed framebuffers need a built palette before anything is drawn.
+    void setPalette(const Palette* palette);
+    const Palette* getPalette() const;
 
     int getWidth() const;
     int getHeight() const;
-    const float* getData() const;
+    // Raw storage, in Layout order.
+    const Pixel* getData() const;
+    // Copies the pixels out as linear rows of getWidth() pixels.
+    void readPixels(Pixel* dst) const;
+    // Same, but only the pixels inside rect; the rest of dst is left untouched.
+    void readPixels(Pixel* dst, const Box& rect) const;
+    // Like readPixels, but converted to RGBA8, expanding indices through the palette.
+    void readColors(Color4b* dst, const Box& rect) const;
+    Box getBounds() const;
 
     void clear();
+    void clear(const Box& clip);
+    void fill(const Box& clip, Color3f col);
+    // Solid run of row y, clipped to the framebuffer. px is already in the pixel format,
+    // for indexed framebuffers as toPixel with getPalette() returns it.
+    void fillSpan(int y, const Span& span, Pixel px);
+    void copy(const BasicFramebuffer& src, const Box& clip);
     void draw(const DrawableBox& element);
+    void draw(const DrawableBox& element, const Box& clip);
+
+    // Dirty rectangles are clipped to the framebuffer and merged with the ones they overlap.
+    void addDirty(const Box& rect);
+    const std::vector<Box>& getDirty() const;
+    void clearDirty();
+
+    // Draws a contiguous range of one concrete drawable type without virtual dispatch.
+    template <typename T>
+    void drawBatch(const T* begin, const T* end);
+    template <typename T>
+    void drawBatch(const T* begin, const T* end, const Box& clip);
 
 private:
-    Bitmap fb;
+    template <typename T>
+    void rasterize(const T& element, const Box& clip, bool solid, Color3f col);
+    // Row y of an element with more runs than MAX_SPANS, one pixel at a time.
+    template <typename T>
+    void rasterizePixels(const T& element, int y, int xmin, int xmax, bool solid, Pixel px);
+    // Masked blit of a whole sprite row; only RGBA8 framebuffers take this path.
+    template <typename T>
+    bool blitMasked(const T& element, int y, int xmin, int xmax, std::true_type);
+    template <typename T>
+    bool blitMasked(const T&, int, int, int, std::false_type) { return false; }
+
+    BasicBitmap<Pixel, Layout> fb;
+    const Palette* palette;
+    std::vector<Box> dirty;
 };
+
+// Presentation format. FRAMEBUFFER_INDEXED stores 8-bit palette indices instead of
+// RGBA8, and FRAMEBUFFER_TILE stores it in square blocks of that many pixels instead of
+// linear rows.
+#ifdef FRAMEBUFFER_INDEXED
+typedef uint8_t FramebufferPixel;
+#else
+typedef Color4b FramebufferPixel;
+#endif
+#ifdef FRAMEBUFFER_TILE
+typedef BasicFramebuffer<FramebufferPixel, TiledLayout<FRAMEBUFFER_TILE>> Framebuffer;
+#else
+typedef BasicFramebuffer<FramebufferPixel> Framebuffer;
+#endif
+
+template <typename Pixel>
+inline void convertRow(const Color3f* src, Pixel* dst, int count, const Palette* palette) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = toPixel<Pixel>(src[i], palette);
+    }
+}
+
+template <>
+inline void convertRow<Color3f>(const Color3f* src, Color3f* dst, int count, const Palette*) {
+    std::copy(src, src + count, dst);
+}
+
+template <typename Pixel, typename Layout>
+template <typename T>
+void BasicFramebuffer<Pixel, Layout>::drawBatch(const T* begin, const T* end) {
+    drawBatch(begin, end, getBounds());
+}
+
+template <typename Pixel, typename Layout>
+template <typename T>
+void BasicFramebuffer<Pixel, Layout>::drawBatch(const T* begin, const T* end, const Box& clip) {
+    if (begin == end) {
+        return;
+    }
+    Color3f shared = begin->getColor(begin->pmin);
+    for (const T* e = begin; e != end; ++e) {
+        if (e->overlaps(clip)) {
+            rasterize(*e, clip, T::solid, T::uniformColor ? shared : e->getColor(e->pmin));
+        }
+    }
+}
+
+template <typename Pixel, typename Layout>
+template <typename T>
+void BasicFramebuffer<Pixel, Layout>::rasterize(const T& element, const Box& clip, bool solid, Color3f col) {
+    int xmin = std::max(clip.xmin(), 0);
+    int xmax = std::min(clip.xmax(), fb.width - 1);
+    int ymin = std::max(element.ymin(), std::max(clip.ymin(), 0));
+    int ymax = std::min(element.ymax(), std::min(clip.ymax(), fb.height - 1));
+
+    Pixel px = toPixel<Pixel>(col, palette);
+    Span spans[MAX_SPANS];
+    for (int y = ymin; y <= ymax; ++y) {
+        if (!solid && blitMasked(element, y, xmin, xmax, std::is_same<Pixel, Color4b>())) {
+            continue;
+        }
+        const Color3f* src = solid ? nullptr : element.getRow(y);
+        int n = element.getSpans(y, spans, MAX_SPANS);
+        if (n > MAX_SPANS) {
+            rasterizePixels(element, y, xmin, xmax, solid, px);
+            continue;
+        }
+        for (int i = 0; i < n; ++i) {
+            int x0 = std::max(spans[i].x0, xmin);
+            int x1 = std::min(spans[i].x1, xmax);
+            while (x0 <= x1) {
+                int end = std::min(x1, Layout::runEnd(x0));
+                int count = end - x0 + 1;
+                Pixel* dst = fb.at(x0, y);
+                if (solid) {
+                    fillPixels(dst, count, px);
+                } else if (src) {
+                    convertRow(src + (x0 - element.xmin()), dst, count, palette);
+                } else {
+                    for (int k = 0; k < count; ++k) {
+                        dst[k] = toPixel<Pixel>(element.getColor(Point(x0 + k, y)), palette);
+                    }
+                }
+                x0 = end + 1;
+            }
+        }
+    }
+}
+
+template <typename Pixel, typename Layout>
+template <typename T>
+void BasicFramebuffer<Pixel, Layout>::rasterizePixels(const T& element, int y, int xmin, int xmax, bool solid,
+    Pixel px) {
+    int x1 = std::min(element.xmax(), xmax);
+    for (int x = std::max(element.xmin(), xmin); x <= x1; ++x) {
+        Point p(x, y);
+        if (element.shouldDraw(p)) {
+            *fb.at(x, y) = solid ? px : toPixel<Pixel>(element.getColor(p), palette);
+        }
+    }
+}
+
+template <typename Pixel, typename Layout>
+template <typename T>
+bool BasicFramebuffer<Pixel, Layout>::blitMasked(const T& element, int y, int xmin, int xmax, std::true_type) {
+    const Color4b* pixels;
+    const uint8_t* mask;
+    if (!element.getMaskedRow(y, pixels, mask)) {
+        return false;
+    }
+    int x0 = std::max(element.xmin(), xmin);
+    int x1 = std::min(element.xmax(), xmax);
+    while (x0 <= x1) {
+        int end = std::min(x1, Layout::runEnd(x0));
+        int off = x0 - element.xmin();
+        kernels().maskedBlit(fb.at(x0, y), pixels + off, mask + off, end - x0 + 1);
+        x0 = end + 1;
+    }
+    return true;
+}
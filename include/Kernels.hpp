@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Bitmap.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+// Pixel kernels for the RGBA8 framebuffer. Every instruction set provides the same
+// table; kernels() picks the widest one the CPU supports the first time it is called.
+struct Kernels {
+    const char* name;
+
+    void (*fillSpan)(Color4b* dst, int count, Color4b col);
+    // Fills height rows of width pixels, rows being stride pixels apart.
+    void (*fillRect)(Color4b* dst, int stride, int width, int height, Color4b col);
+    // Copies src[i] to dst[i] where mask[i] is non-zero.
+    void (*maskedBlit)(Color4b* dst, const Color4b* src, const uint8_t* mask, int count);
+    // dst[i] = palette[src[i]], palette having 256 entries.
+    void (*expandIndices)(Color4b* dst, const uint8_t* src, const Color4b* palette, int count);
+};
+
+const Kernels& kernels();
+
+// Individual variants, null when not built or not supported by this CPU.
+const Kernels* scalarKernels();
+const Kernels* sse2Kernels();
+const Kernels* avx2Kernels();
+const Kernels* avx512Kernels();
+
+// Generic fallbacks for the other pixel formats, RGBA8 goes through the kernels.
+template <typename Pixel>
+inline void fillPixels(Pixel* dst, int count, Pixel col) {
+    std::fill(dst, dst + count, col);
+}
+
+inline void fillPixels(Color4b* dst, int count, Color4b col) {
+    kernels().fillSpan(dst, count, col);
+}
+
+template <typename Pixel>
+inline void fillPixels(Pixel* dst, int stride, int width, int height, Pixel col) {
+    for (int y = 0; y < height; ++y) {
+        fillPixels(dst + y * stride, width, col);
+    }
+}
+
+inline void fillPixels(Color4b* dst, int stride, int width, int height, Color4b col) {
+    kernels().fillRect(dst, stride, width, height, col);
+}
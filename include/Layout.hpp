@@ -0,0 +1,30 @@
+#pragma once
+
+#include <climits>
+
+// Memory layouts for bitmaps. offset() maps a pixel to its index in storage, and
+// runEnd(x) is the last column whose pixel directly follows (x, y) in memory on the
+// same row, so row spans can be written as a few contiguous runs.
+struct LinearLayout {
+    static constexpr bool linear = true;
+
+    static int storage(int width, int height) { return width * height; }
+    static int offset(int x, int y, int width) { return y * width + x; }
+    static int runEnd(int) { return INT_MAX; }
+};
+
+// Blocks of Size x Size pixels stored contiguously, blocks in row-major order.
+template <int Size>
+struct TiledLayout {
+    static_assert((Size & (Size - 1)) == 0, "Tile size must be a power of two");
+
+    static constexpr bool linear = false;
+
+    static int blocks(int n) { return (n + Size - 1) / Size; }
+    static int storage(int width, int height) { return blocks(width) * blocks(height) * Size * Size; }
+    static int offset(int x, int y, int width) {
+        int block = (y / Size) * blocks(width) + x / Size;
+        return block * Size * Size + (y % Size) * Size + x % Size;
+    }
+    static int runEnd(int x) { return x | (Size - 1); }
+};
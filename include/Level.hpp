@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Drawable.hpp"
+#include "Entities.hpp"
+#include "Palette.hpp"
+
+#include <vector>
+
+// The entities of the playfield, laid out for a screen of the given size.
+struct Level {
+    Level(int width, int height);
+    // Copy of level with every position and size multiplied by scale.
+    Level(const Level& level, float scale);
+
+    // Adds every color the entities can produce.
+    void fillPalette(Palette& palette) const;
+
+    Pacman pacman;
+    Ghost redGhost;
+    Ghost greenGhost;
+    Ghost blueGhost;
+    Entities coins;
+    std::vector<Wall> walls;
+};
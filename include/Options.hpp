@@ -0,0 +1,54 @@
+#pragma once
+
+enum RenderMode {
+    render_retained, render_immediate, render_tiled
+};
+
+enum UploadMode {
+    upload_direct, upload_pbo
+};
+
+enum UploadFormat {
+    format_rgba8, format_rgb10a2, format_palette
+};
+
+enum PacingMode {
+    pacing_vsync, pacing_adaptive, pacing_uncapped, pacing_limit
+};
+
+enum UpscaleFilter {
+    upscale_nearest, upscale_sharp
+};
+
+struct Options {
+    Options();
+
+    RenderMode mode;
+    UploadMode upload;
+    UploadFormat format;
+    PacingMode pacing;
+    // Target rate of pacing_limit.
+    int fps;
+    // Internal resolution as a fraction of the window, in (0, 1].
+    float scale;
+    UpscaleFilter upscale;
+    // Render time the dynamic resolution holds, 0 keeps the scale fixed.
+    float targetMs;
+    int threads;
+    // Stop after this many frames, 0 runs until the window is closed.
+    int frames;
+    // Write every frame as a PPM image into this directory.
+    const char* dumpDir;
+    // Draw the frame timing overlay, needs a build with ENABLE_PROFILER.
+    bool hud;
+    // Print per-phase timings of the last frames on exit, needs ENABLE_PROFILER.
+    bool stats;
+    // Sleep until something changes instead of redrawing every frame.
+    bool idle;
+    // Frames handed to the presentation thread that may wait for upload, 0 presents
+    // on the main thread.
+    int pipeline;
+};
+
+// Without a window, the options that only apply to presenting are rejected.
+bool parseOptions(int argc, char** argv, Options& opts, bool window);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Bitmap.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Up to 256 colors that 8-bit indices refer to. build() fills a table from every
+// 5:6:5 color to its nearest entry, so quantizing a pixel is a single lookup.
+struct Palette {
+    Palette();
+
+    // Returns the index of col, adding it if there is room, else the nearest entry.
+    uint8_t add(Color3f col);
+    // Adds count shades from black to col, for sprites that are a tinted mask.
+    void addRamp(Color3f col, int count);
+    // Must be called after the last add and before lookup or quantize.
+    void build();
+
+    uint8_t lookup(Color4b col) const {
+        return lut[(col.r >> 3) << 11 | (col.g >> 2) << 5 | col.b >> 3];
+    }
+    void quantize(const Color4b* src, uint8_t* dst, int count) const;
+
+    Color4b colors[256];
+    int size;
+
+private:
+    uint8_t nearest(Color4b col) const;
+
+    std::vector<uint8_t> lut;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Framebuffer.hpp"
+#include "Palette.hpp"
+#include "Trace.hpp"
+
+#include <chrono>
+
+enum Phase {
+    phase_clear, phase_background, phase_coins, phase_walls, phase_pacman, phase_ghosts,
+    phase_dynamic, phase_tiles, phase_upload, phase_swap, phase_count
+};
+
+const char* getPhaseName(Phase phase);
+
+// Per-phase frame timings for the last PROFILER_FRAMES frames. Phases are timed with
+// PROFILE_SCOPE, which compiles to nothing unless ENABLE_PROFILER is defined and also
+// emits a trace zone. Only the thread that runs the frame loop may record.
+struct Profiler {
+    static Profiler& get();
+
+    void record(Phase phase, double ms);
+    // Closes the current frame and starts accumulating the next one.
+    void endFrame();
+
+    double average(Phase phase) const;
+    double percentile(Phase phase, float p) const;
+    double averageFrame() const;
+    double percentileFrame(float p) const;
+
+    // Box covered by drawHud in the top left corner of fb, so callers can restore it
+    // before the next overlay.
+    Box getHudBounds(const Framebuffer& fb) const;
+    void drawHud(Framebuffer& fb) const;
+    void addHudColors(Palette& palette) const;
+    // Prints the same table to stdout, skipping phases that never ran.
+    void print() const;
+
+private:
+    Profiler();
+
+    double percentile(const float* samples, int stride, float p) const;
+
+    float samples[PROFILER_FRAMES][phase_count];
+    float frameTimes[PROFILER_FRAMES];
+    float current[phase_count];
+    int next;
+    int count;
+    std::chrono::steady_clock::time_point frameStart;
+};
+
+struct ScopedTimer {
+    ScopedTimer(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> elapsed = end - start;
+        Profiler::get().record(phase, elapsed.count());
+        if (Trace::enabled()) {
+            Trace::zone(getPhaseName(phase), start, end);
+        }
+    }
+
+private:
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_SCOPE(phase) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(phase)
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Level.hpp"
+#include "Options.hpp"
+#include "Palette.hpp"
+#include "Scene.hpp"
+#include "TileRenderer.hpp"
+
+// Draws a level into a framebuffer with the rendering mode selected in the options.
+struct Renderer {
+    Renderer(const Options& opts, Framebuffer& fb, Level& level);
+    ~Renderer();
+
+    void render();
+
+    Scene& getScene();
+    // Colors of the level and the overlay, which indexed framebuffers refer to.
+    const Palette& getPalette() const;
+
+private:
+    void renderImmediate();
+
+    RenderMode mode;
+    bool hud;
+    Framebuffer& fb;
+    Level& level;
+    Scene scene;
+    TileRenderer* tiles;
+    Palette palette;
+};
+
+// Writes the framebuffer to dir/frame_NNNNN.ppm.
+bool dumpFrame(const Framebuffer& fb, const char* dir, int frame);
@@ -0,0 +1,20 @@
+#pragma once
+
+// Dynamic resolution. Picks the internal resolution scale, in steps of RES_STEP between
+// RES_MIN_SCALE and 1, that keeps the smoothed render time under a target. Render time
+// is assumed to grow with the pixel count, i.e. with the square of the scale.
+struct ResolutionController {
+    ResolutionController(float targetMs, float scale);
+
+    // Feeds the render time of one frame. Returns true when the scale changed, which
+    // happens at most once every RES_INTERVAL frames.
+    bool update(double ms);
+
+    float getScale() const;
+
+private:
+    float targetMs;
+    float scale;
+    double average;
+    int frames;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Entities.hpp"
+#include "Framebuffer.hpp"
+
+#include <vector>
+
+enum Layer {
+    layer_static, layer_dynamic
+};
+
+// Retained list of drawables. Static elements are always drawn beneath dynamic ones,
+// otherwise elements are drawn in the order they were added. Every change goes
+// through add/move/moveTo/hideEntity, which marks the affected bounds dirty in the
+// framebuffer, so render() only touches the pixels that may have changed.
+//
+// The static layer is rasterized into a cached background once. Dirty regions are
+// restored by copying from it, and a static change only re-rasterizes its own bounds
+// in the cache. An entity store can be part of the static layer, beneath its elements.
+struct Scene {
+    Scene(Framebuffer& fb);
+
+    void add(DrawableBox* element, Layer layer = layer_dynamic);
+    void move(DrawableBox* element, int dx, int dy);
+    void moveTo(DrawableBox* element, const FixedPoint& pos);
+    void setEntities(Entities* entities);
+    // Hides entity id of the store, a no-op when it already is hidden.
+    void hideEntity(int id);
+
+    void render();
+
+    const std::vector<DrawableBox*>& getElements() const;
+    const Entities* getEntities() const;
+
+private:
+    void renderBackground();
+    void renderDirty();
+    bool isStatic(const DrawableBox* element) const;
+    void invalidate(const DrawableBox* element);
+    void invalidateStatic(const Box& rect);
+
+    Framebuffer& fb;
+    Framebuffer background;
+    std::vector<DrawableBox*> elements;
+    size_t staticCount;
+    Entities* entities;
+    // Built on the first render after setEntities. Hiding only clears visible, so the
+    // bins stay valid.
+    EntityBins entityBins;
+    bool binsStale;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Entities.hpp"
+#include "Level.hpp"
+#include "Scene.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Positions of the moving entities.
+struct Actors {
+    Point pacman;
+    // Red, green and blue.
+    Point ghosts[3];
+};
+
+// State of the level after one simulation tick, in the coordinates of the unscaled level.
+// Positions before the tick are kept as well, so that rendering can blend between them.
+struct Snapshot {
+    long tick;
+    // When the tick was due.
+    std::chrono::steady_clock::time_point time;
+    Actors previous;
+    Actors current;
+    Direction direction;
+    // Indexed by the entity ids of Level::coins.
+    std::vector<bool> eaten;
+};
+
+// Runs the game logic on its own thread with a fixed timestep of 1 / SIM_HZ. Pacman moves
+// in the direction last set from input, ghosts wander, and both are stopped by walls.
+// Ticks that come due late are caught up, up to SIM_MAX_CATCHUP of them, so the game
+// runs at the same speed however slow the rendering is. After a tick that changed
+// anything the new state is published as an immutable snapshot, which the render thread
+// takes without locking, so a slow frame never holds up the logic.
+struct Simulation {
+    // wake, if set, is called from the simulation thread after every publish.
+    Simulation(const Level& level, void (*wake)() = nullptr);
+    ~Simulation();
+
+    // Thread safe, takes effect on the next tick.
+    void setDirection(Direction dir);
+    // Thread safe. A paused simulation neither ticks nor wakes anyone, and on resume it
+    // carries on from the current time rather than catching up on the pause.
+    void setPaused(bool paused);
+
+    // Render thread only. Returns true when a newer snapshot than getSnapshot() arrived.
+    bool update();
+    const Snapshot& getSnapshot() const;
+
+private:
+    void run();
+    bool step();
+    bool blocked(const Point& center, int rad) const;
+
+    Snapshot state;
+    TripleBuffer<Snapshot> snapshots;
+    std::vector<Box> walls;
+    // The simulation's own copy of Level::coins, eaten ones hidden.
+    Entities coins;
+    std::vector<int> hits;
+    int pacmanRad;
+    int ghostRad;
+    Direction ghostDirs[3];
+    std::mt19937 rng;
+    std::atomic<int> input;
+    void (*wake)();
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool paused;
+    std::atomic<bool> stop;
+    std::thread thread;
+};
+
+// How far rendering at now is between the previous and current positions of the snapshot.
+// Blending lags the simulation by a tick, so that there always are two states to blend.
+float getBlend(const Snapshot& snapshot, std::chrono::steady_clock::time_point now);
+
+// Moves the entities of a level scaled by scale to the positions blend of the way from
+// the previous to the current ones, through the scene so that everything that moved is
+// redrawn. Eaten coins are hidden in the scene.
+void applySnapshot(const Snapshot& snapshot, float blend, Level& level, Scene& scene, float scale);
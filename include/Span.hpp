@@ -0,0 +1,9 @@
+#pragma once
+
+struct Span {
+    Span() {}
+    Span(int x0, int x1) : x0(x0), x1(x1) {}
+
+    int x0;
+    int x1;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Bitmap.hpp"
+#include "Span.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// A bitmap resampled once to its on-screen size. The intensity of every source pixel
+// becomes an 8-bit coverage value. Tinted copies are built once per color together
+// with the covered runs of each row, so drawing the sprite is a masked blit.
+struct Sprite {
+    struct Tint {
+        Color3f color;
+        std::vector<Color3f> pixels;
+        // RGBA8 copy of pixels, and 255 where the pixel is covered, 0 elsewhere.
+        std::vector<Color4b> packed;
+        std::vector<uint8_t> covered;
+        std::vector<Span> spans;
+        // Runs of row y are spans[rowStart[y]] up to spans[rowStart[y + 1]].
+        std::vector<int> rowStart;
+    };
+
+    Sprite(const Bitmap& src, int width, int height, float threshold);
+
+    // Not thread safe; returned references stay valid for the lifetime of the sprite.
+    const Tint& getTint(Color3f color);
+
+    int width;
+    int height;
+    std::vector<uint8_t> mask;
+
+private:
+    float threshold;
+    std::deque<Tint> tints;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+// Bounded single producer, single consumer queue. Each index is written by one side
+// only and published with release, so push and pop never lock. Callers that need to
+// block on an empty or full queue have to park themselves.
+template <typename T, int Capacity>
+struct SpscQueue {
+    // Indices wrap around at 2^32, which Capacity has to divide.
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer only. Returns false when the queue is full.
+    bool push(const T& value) {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[t % Capacity] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false when the queue is empty.
+    bool pop(T& value) {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[h % Capacity];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T slots[Capacity];
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+};
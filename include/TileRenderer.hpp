@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Entities.hpp"
+#include "Framebuffer.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Splits the framebuffer into TILE_SIZE squares and rasterizes them on a pool of
+// worker threads. Each tile is owned by exactly one thread per frame, so pixel
+// writes need no locking, and elements keep their submission order inside a tile.
+struct TileRenderer {
+    TileRenderer(int threads);
+    ~TileRenderer();
+
+    // entities, if set, are drawn beneath the elements.
+    void render(Framebuffer& fb, const Entities* entities, const std::vector<DrawableBox*>& elements);
+
+private:
+    void bin(const Framebuffer& fb, const Entities* entities, const std::vector<DrawableBox*>& elements);
+    void renderTiles();
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+    unsigned frame;
+    int busyWorkers;
+    bool stop;
+
+    Framebuffer* target;
+    const Entities* entities;
+    const std::vector<DrawableBox*>* elements;
+    int tilesX;
+    int tilesY;
+    std::vector<std::vector<int>> bins;
+    EntityBins entityBins;
+    std::atomic<int> nextTile;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+
+// Timeline of named zones in the Chrome trace-event format, which ui.perfetto.dev and
+// chrome://tracing load directly. Nothing is recorded unless the ZAVLADI_TRACE
+// environment variable names an output file. Every thread appends to its own buffer
+// of TRACE_EVENTS zones, so recording never takes a lock; zones past that are dropped.
+struct Trace {
+    typedef std::chrono::steady_clock Clock;
+
+    static bool enabled();
+    // Adds a finished zone to the calling thread. name must be a string literal.
+    static void zone(const char* name, Clock::time_point start, Clock::time_point end);
+    static void setThreadName(const char* name);
+    // Writes the zones of all threads to the ZAVLADI_TRACE file. Call it once recording
+    // threads are idle.
+    static bool write();
+};
+
+struct TraceZone {
+    TraceZone(const char* name) : name(name) {
+        if (Trace::enabled()) {
+            start = Trace::Clock::now();
+        }
+    }
+
+    ~TraceZone() {
+        if (Trace::enabled()) {
+            Trace::zone(name, start, Trace::Clock::now());
+        }
+    }
+
+private:
+    const char* name;
+    Trace::Clock::time_point start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef ENABLE_PROFILER
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+
+// Single producer, single consumer hand-off of the newest value. The writer fills
+// back() and publishes it, the reader takes the newest published value with update()
+// and keeps reading front() until the next one. Neither side ever waits: the three
+// slots are exchanged through one atomic index, and a value the reader has not picked
+// up yet is simply replaced by a newer one.
+template <typename T>
+struct TripleBuffer {
+    TripleBuffer(const T& init) : back(0), middle(1), front(2) {
+        for (T& slot : slots) {
+            slot = init;
+        }
+    }
+
+    T& getBack() {
+        return slots[back];
+    }
+
+    void publish() {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & ~fresh;
+    }
+
+    // Returns true when a newer value than front() was published.
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & fresh)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~fresh;
+        return true;
+    }
+
+    const T& getFront() const {
+        return slots[front];
+    }
+
+private:
+    static const int fresh = 4;
+
+    T slots[3];
+    int back;
+    std::atomic<int> middle;
+    int front;
+};
@@ -1,11 +1,31 @@
 #pragma once
 
 #include "Framebuffer.hpp"
+#include "Options.hpp"
+#include "Palette.hpp"
 
 struct GLFWwindow;
 
-GLFWwindow* createWindow(int width, int height);
+GLFWwindow* createWindow(int width, int height, const Options& opts);
 void destroyWindow(GLFWwindow* window);
 
 Framebuffer* getWindowFramebuffer(GLFWwindow* window);
+// Replaces the framebuffer with one of the given size, at most the window size, that the
+// display stretches over the window. The previous framebuffer is deleted.
+Framebuffer* resizeWindowFramebuffer(GLFWwindow* window, int width, int height);
+// Uploads and presents the frame, or with a pipeline started only queues what changed
+// and returns.
 void displayWindowFramebuffer(GLFWwindow* window);
+// Moves upload and presentation to a thread that owns the GL context from now on, with
+// up to depth frames queued for it. setWindowPalette must be called before this.
+bool startWindowPipeline(GLFWwindow* window, int depth);
+// Waits until the presentation thread is done with every queued frame. Those refer to
+// the palette of the framebuffer, so this has to come before the palette goes away.
+void drainWindowPipeline(GLFWwindow* window);
+// True while the window is minimized or hidden, when nothing drawn would be seen.
+bool isWindowHidden(GLFWwindow* window);
+// Whether input or a request to repaint arrived since the last call.
+bool takeWindowEvents(GLFWwindow* window);
+// Built palette that --format palette quantizes to, the framebuffer's own one when it
+// stores indices.
+void setWindowPalette(GLFWwindow* window, const Palette& palette);
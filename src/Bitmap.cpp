@@ -1,26 +1,31 @@
 #include "Bitmap.hpp"
+#include "Kernels.hpp"
 
+#include <algorithm>
 #include <cstdio>
 #include <stdexcept>
 
-Bitmap::Bitmap(int width, int height) : width(width), height(height) {
-    int pixels = width * height;
-    data = new Color3f[pixels];
+template <typename Pixel, typename Layout>
+BasicBitmap<Pixel, Layout>::BasicBitmap(int width, int height) : width(width), height(height) {
+    data = new Pixel[Layout::storage(width, height)];
 }
 
-Bitmap::Bitmap(const char* path, int width, int height) {
+template <typename Pixel, typename Layout>
+BasicBitmap<Pixel, Layout>::BasicBitmap(const char* path, int width, int height) {
+    if (!Layout::linear) {
+        throw std::runtime_error("Bitmap files are stored in linear rows");
+    }
     FILE* fp = fopen(path, "r");
     if (!fp) {
         throw std::runtime_error("Failed to open bitmap file");
     }
 
     int pixels = width * height;
-    Color3f* buf = new Color3f[pixels];
-    int components = pixels * 3;
-    int n = fread(buf, sizeof(float), components, fp);
+    Pixel* buf = new Pixel[pixels];
+    int n = fread(buf, sizeof(Pixel), pixels, fp);
     fclose(fp);
 
-    if (n != components) {
+    if (n != pixels) {
         delete[] buf;
         throw std::runtime_error("Failed to read bitmap data");
     }
@@ -30,18 +35,34 @@ Bitmap::Bitmap(const char* path, int width, int height) {
     this->data = buf;
 }
 
-Bitmap::~Bitmap() {
+template <typename Pixel, typename Layout>
+BasicBitmap<Pixel, Layout>::~BasicBitmap() {
     delete[] data;
 }
 
-void Bitmap::draw(int x, int y, Color3f col) {
+template <typename Pixel, typename Layout>
+void BasicBitmap<Pixel, Layout>::draw(int x, int y, Pixel col) {
     if (x >= 0 && x < width) {
         if (y >= 0 && y < height) {
-            data[y * width + x] = col;
+            *at(x, y) = col;
         }
     }
 }
 
+template <typename Pixel, typename Layout>
+void BasicBitmap<Pixel, Layout>::fill(int x0, int x1, int y, Pixel col) {
+    if (y < 0 || y >= height) {
+        return;
+    }
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, width - 1);
+    while (x0 <= x1) {
+        int end = std::min(x1, Layout::runEnd(x0));
+        fillPixels(at(x0, y), end - x0 + 1, col);
+        x0 = end + 1;
+    }
+}
+
 static int clamp(int x, int xmin, int xmax) {
     if (x < xmin) {
         return xmin;
@@ -52,14 +73,24 @@ static int clamp(int x, int xmin, int xmax) {
     return x;
 }
 
-Color3f Bitmap::sample(int x, int y) const {
+template <typename Pixel, typename Layout>
+Pixel BasicBitmap<Pixel, Layout>::sample(int x, int y) const {
     x = clamp(x, 0, width - 1);
     y = clamp(y, 0, height - 1);
-    return data[y * width + x];
+    return *at(x, y);
 }
 
-Color3f Bitmap::sample(float u, float v) const {
+template <typename Pixel, typename Layout>
+Pixel BasicBitmap<Pixel, Layout>::sample(float u, float v) const {
     int x = u * (width - 1);
     int y = v * (height - 1);
     return sample(x, y);
 }
+
+template struct BasicBitmap<Color3f>;
+template struct BasicBitmap<Color4b>;
+template struct BasicBitmap<Color4b, TiledLayout<8>>;
+template struct BasicBitmap<Color4b, TiledLayout<16>>;
+template struct BasicBitmap<uint8_t>;
+template struct BasicBitmap<uint8_t, TiledLayout<8>>;
+template struct BasicBitmap<uint8_t, TiledLayout<16>>;
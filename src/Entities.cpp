@@ -0,0 +1,69 @@
+#include "Entities.hpp"
+
+#include <algorithm>
+
+int Entities::add(EntityType t, const FixedPoint& pos, Fixed r, Color3f col) {
+    x.push_back(pos.x);
+    y.push_back(pos.y);
+    rad.push_back(r);
+    color.push_back(col);
+    type.push_back(t);
+    visible.push_back(1);
+    return size() - 1;
+}
+
+int Entities::size() const {
+    return (int)x.size();
+}
+
+Box Entities::getBounds(int id) const {
+    return circleBounds(FixedPoint(x[id], y[id]), rad[id]);
+}
+
+void collideEntities(const Entities& entities, EntityType type, const FixedPoint& center, Fixed rad,
+    std::vector<int>& hits) {
+    int count = entities.size();
+    for (int i = 0; i < count; ++i) {
+        if (entities.type[i] != type || !entities.visible[i]) {
+            continue;
+        }
+        int64_t dx = (int64_t)entities.x[i] - center.x;
+        int64_t dy = (int64_t)entities.y[i] - center.y;
+        int64_t reach = (int64_t)entities.rad[i] + rad;
+        if (dx * dx + dy * dy <= reach * reach) {
+            hits.push_back(i);
+        }
+    }
+}
+
+void EntityBins::build(const Entities& entities, int width, int height) {
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    bins.resize(tilesX * tilesY);
+    for (std::vector<int>& b : bins) {
+        b.clear();
+    }
+
+    int count = entities.size();
+    for (int i = 0; i < count; ++i) {
+        if (!entities.visible[i]) {
+            continue;
+        }
+        Box box = entities.getBounds(i);
+        int tx0 = std::max(box.xmin() / TILE_SIZE, 0);
+        int tx1 = std::min(box.xmax() / TILE_SIZE, tilesX - 1);
+        int ty0 = std::max(box.ymin() / TILE_SIZE, 0);
+        int ty1 = std::min(box.ymax() / TILE_SIZE, tilesY - 1);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                bins[ty * tilesX + tx].push_back(i);
+            }
+        }
+    }
+}
+
+Box EntityBins::getTileBounds(int tile) const {
+    int tx = tile % tilesX;
+    int ty = tile / tilesX;
+    return Box(Point(tx * TILE_SIZE, ty * TILE_SIZE), Point((tx + 1) * TILE_SIZE - 1, (ty + 1) * TILE_SIZE - 1));
+}
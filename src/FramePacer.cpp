@@ -0,0 +1,75 @@
+#include "FramePacer.hpp"
+#include "Config.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+FramePacer::FramePacer(PacingMode mode, int fps) :
+    mode(mode), period(std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / std::max(fps, 1)),
+    started(false), count(0), mean(0.0), m2(0.0), minInterval(0.0), maxInterval(0.0) {}
+
+void FramePacer::endFrame() {
+    if (mode == pacing_limit) {
+        Clock::time_point now = Clock::now();
+        if (!started || now > deadline + period) {
+            // First frame, or too far behind to catch up without a burst of frames.
+            deadline = now + period;
+        } else {
+            TRACE_ZONE("pace");
+            waitUntil(deadline);
+            deadline += period;
+        }
+    }
+
+    Clock::time_point now = Clock::now();
+    if (started) {
+        // Welford's running mean and variance.
+        double ms = std::chrono::duration<double, std::milli>(now - last).count();
+        ++count;
+        double delta = ms - mean;
+        mean += delta / count;
+        m2 += delta * (ms - mean);
+        minInterval = count == 1 ? ms : std::min(minInterval, ms);
+        maxInterval = count == 1 ? ms : std::max(maxInterval, ms);
+    }
+    last = now;
+    started = true;
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline) const {
+    Clock::time_point sleepEnd = deadline - std::chrono::microseconds(PACER_SPIN_US);
+    if (Clock::now() < sleepEnd) {
+        std::this_thread::sleep_until(sleepEnd);
+    }
+    while (Clock::now() < deadline) {
+    }
+}
+
+double FramePacer::meanInterval() const {
+    return mean;
+}
+
+double FramePacer::jitter() const {
+    return count > 1 ? std::sqrt(m2 / (count - 1)) : 0.0;
+}
+
+void FramePacer::print() const {
+    printf("%s: %ld frames, %.3f ms mean, %.3f ms jitter, %.3f..%.3f ms\n", getPacingName(mode), count,
+        meanInterval(), jitter(), minInterval, maxInterval);
+}
+
+const char* getPacingName(PacingMode mode) {
+    switch (mode) {
+        case pacing_vsync:
+            return "vsync";
+        case pacing_adaptive:
+            return "adaptive";
+        case pacing_limit:
+            return "limit";
+        default:
+            return "uncapped";
+    }
+}
@@ -1,34 +1,177 @@
 #include "Framebuffer.hpp"
 
-Framebuffer::Framebuffer(int width, int height) : fb(width, height) {}
+template <typename Pixel, typename Layout>
+BasicFramebuffer<Pixel, Layout>::BasicFramebuffer(int width, int height) : fb(width, height), palette(nullptr) {}
 
-int Framebuffer::getWidth() const {
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::setPalette(const Palette* palette) {
+    this->palette = palette;
+}
+
+template <typename Pixel, typename Layout>
+const Palette* BasicFramebuffer<Pixel, Layout>::getPalette() const {
+    return palette;
+}
+
+template <typename Pixel, typename Layout>
+int BasicFramebuffer<Pixel, Layout>::getWidth() const {
     return fb.width;
 }
 
-int Framebuffer::getHeight() const {
+template <typename Pixel, typename Layout>
+int BasicFramebuffer<Pixel, Layout>::getHeight() const {
     return fb.height;
 }
 
-const float* Framebuffer::getData() const {
-    return reinterpret_cast<float*>(fb.data);
+template <typename Pixel, typename Layout>
+const Pixel* BasicFramebuffer<Pixel, Layout>::getData() const {
+    return fb.data;
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::readPixels(Pixel* dst) const {
+    if (Layout::linear) {
+        std::copy(fb.data, fb.data + fb.width * fb.height, dst);
+        return;
+    }
+    readPixels(dst, getBounds());
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::readPixels(Pixel* dst, const Box& rect) const {
+    Box r = rect.intersect(getBounds());
+    for (int y = r.ymin(); y <= r.ymax(); ++y) {
+        Pixel* row = dst + y * fb.width;
+        for (int x = r.xmin(); x <= r.xmax();) {
+            int end = std::min(r.xmax(), Layout::runEnd(x));
+            std::copy(fb.at(x, y), fb.at(x, y) + (end - x + 1), row + x);
+            x = end + 1;
+        }
+    }
+}
+
+static void toColor4b(const Color4b* src, Color4b* dst, int count, const Palette*) {
+    std::copy(src, src + count, dst);
+}
+
+static void toColor4b(const uint8_t* src, Color4b* dst, int count, const Palette* palette) {
+    kernels().expandIndices(dst, src, palette->colors, count);
+}
+
+static void toColor4b(const Color3f* src, Color4b* dst, int count, const Palette*) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = convertColor<Color4b>(src[i]);
+    }
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::readColors(Color4b* dst, const Box& rect) const {
+    Box r = rect.intersect(getBounds());
+    for (int y = r.ymin(); y <= r.ymax(); ++y) {
+        Color4b* row = dst + y * fb.width;
+        for (int x = r.xmin(); x <= r.xmax();) {
+            int end = std::min(r.xmax(), Layout::runEnd(x));
+            toColor4b(fb.at(x, y), row + x, end - x + 1, palette);
+            x = end + 1;
+        }
+    }
+}
+
+template <typename Pixel, typename Layout>
+Box BasicFramebuffer<Pixel, Layout>::getBounds() const {
+    return Box(Point(0, 0), Point(fb.width - 1, fb.height - 1));
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::clear() {
+    clear(getBounds());
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::clear(const Box& clip) {
+    fill(clip, Color3f(0.f, 0.f, 0.f));
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::fill(const Box& clip, Color3f col) {
+    Box r = clip.intersect(getBounds());
+    if (r.empty()) {
+        return;
+    }
+    Pixel px = toPixel<Pixel>(col, palette);
+    if (Layout::linear) {
+        fillPixels(fb.at(r.xmin(), r.ymin()), fb.width, r.xmax() - r.xmin() + 1, r.ymax() - r.ymin() + 1, px);
+        return;
+    }
+    for (int y = r.ymin(); y <= r.ymax(); ++y) {
+        fb.fill(r.xmin(), r.xmax(), y, px);
+    }
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::fillSpan(int y, const Span& span, Pixel px) {
+    fb.fill(span.x0, span.x1, y, px);
 }
 
-void Framebuffer::clear() {
-    for (int x = 0; x < fb.width; ++x) {
-        for (int y = 0; y < fb.height; ++y) {
-            fb.draw(x, y, Color3f(0.f, 0.f, 0.f));
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::copy(const BasicFramebuffer& src, const Box& clip) {
+    Box r = clip.intersect(getBounds()).intersect(src.getBounds());
+    if (r.empty()) {
+        return;
+    }
+    for (int y = r.ymin(); y <= r.ymax(); ++y) {
+        for (int x = r.xmin(); x <= r.xmax();) {
+            int end = std::min(r.xmax(), Layout::runEnd(x));
+            std::copy(src.fb.at(x, y), src.fb.at(x, y) + (end - x + 1), fb.at(x, y));
+            x = end + 1;
         }
     }
 }
 
-void Framebuffer::draw(const DrawableBox& element) {
-    for (int x = element.xmin(); x <= element.xmax(); ++x) {
-        for (int y = element.ymin(); y <= element.ymax(); ++y) {
-            Point p(x, y);
-            if (element.shouldDraw(p)) {
-                fb.draw(x, y, element.getColor(p));
-            }
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::draw(const DrawableBox& element) {
+    draw(element, getBounds());
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::draw(const DrawableBox& element, const Box& clip) {
+    rasterize(element, clip, element.isSolid(), element.getColor(element.pmin));
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::addDirty(const Box& rect) {
+    Box r = rect.intersect(getBounds());
+    if (r.empty()) {
+        return;
+    }
+    size_t i = 0;
+    while (i < dirty.size()) {
+        if (dirty[i].overlaps(r)) {
+            r = r.unite(dirty[i]);
+            dirty[i] = dirty.back();
+            dirty.pop_back();
+            i = 0;
+        } else {
+            ++i;
         }
     }
+    dirty.push_back(r);
 }
+
+template <typename Pixel, typename Layout>
+const std::vector<Box>& BasicFramebuffer<Pixel, Layout>::getDirty() const {
+    return dirty;
+}
+
+template <typename Pixel, typename Layout>
+void BasicFramebuffer<Pixel, Layout>::clearDirty() {
+    dirty.clear();
+}
+
+template struct BasicFramebuffer<Color3f>;
+template struct BasicFramebuffer<Color4b>;
+template struct BasicFramebuffer<Color4b, TiledLayout<8>>;
+template struct BasicFramebuffer<Color4b, TiledLayout<16>>;
+template struct BasicFramebuffer<uint8_t>;
+template struct BasicFramebuffer<uint8_t, TiledLayout<8>>;
+template struct BasicFramebuffer<uint8_t, TiledLayout<16>>;
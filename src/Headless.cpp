@@ -0,0 +1,52 @@
+#include "FramePacer.hpp"
+#include "Level.hpp"
+#include "Options.hpp"
+#include "Profiler.hpp"
+#include "Renderer.hpp"
+#include "Trace.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// Drives the same level and rendering pipeline as the window, without a display.
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts, false)) {
+        return 1;
+    }
+    int frames = opts.frames > 0 ? opts.frames : HEADLESS_FRAMES;
+
+    // Fixed internal resolution, there is no display to scale to.
+    Framebuffer fb((int)std::lround(SCREEN_WIDTH * opts.scale), (int)std::lround(SCREEN_HEIGHT * opts.scale));
+    Level level(Level(SCREEN_WIDTH, SCREEN_HEIGHT), opts.scale);
+    Renderer renderer(opts, fb, level);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Trace::setThreadName("main");
+    FramePacer pacer(opts.pacing, opts.fps);
+    for (int frame = 0; frame < frames; ++frame) {
+        TRACE_ZONE("frame");
+        {
+            TRACE_ZONE("render");
+            renderer.render();
+        }
+        if (opts.dumpDir) {
+            TRACE_ZONE("dump");
+            if (!dumpFrame(fb, opts.dumpDir, frame)) {
+                return 1;
+            }
+        }
+        fb.clearDirty();
+        pacer.endFrame();
+        Profiler::get().endFrame();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%d frames in %.2f ms (%.3f ms/frame)\n", frames, elapsed.count(), elapsed.count() / frames);
+    pacer.print();
+    if (opts.stats) {
+        Profiler::get().print();
+    }
+    return Trace::write() ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "Kernels.hpp"
+
+static void fillSpan(Color4b* dst, int count, Color4b col) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = col;
+    }
+}
+
+static void fillRect(Color4b* dst, int stride, int width, int height, Color4b col) {
+    for (int y = 0; y < height; ++y) {
+        fillSpan(dst + y * stride, width, col);
+    }
+}
+
+static void maskedBlit(Color4b* dst, const Color4b* src, const uint8_t* mask, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (mask[i]) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+static void expandIndices(Color4b* dst, const uint8_t* src, const Color4b* palette, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = palette[src[i]];
+    }
+}
+
+const Kernels* scalarKernels() {
+    static const Kernels k = { "scalar", fillSpan, fillRect, maskedBlit, expandIndices };
+    return &k;
+}
+
+#ifndef HAVE_X86_KERNELS
+const Kernels* sse2Kernels() {
+    return nullptr;
+}
+
+const Kernels* avx2Kernels() {
+    return nullptr;
+}
+
+const Kernels* avx512Kernels() {
+    return nullptr;
+}
+#endif
+
+static const Kernels* selectKernels() {
+    const Kernels* candidates[] = { avx512Kernels(), avx2Kernels(), sse2Kernels() };
+    for (const Kernels* k : candidates) {
+        if (k) {
+            return k;
+        }
+    }
+    return scalarKernels();
+}
+
+const Kernels& kernels() {
+    static const Kernels* k = selectKernels();
+    return *k;
+}
@@ -0,0 +1,62 @@
+#include "Kernels.hpp"
+
+#include <cstring>
+#include <immintrin.h>
+
+static __m256i splat(Color4b col) {
+    int v;
+    memcpy(&v, &col, sizeof(v));
+    return _mm256_set1_epi32(v);
+}
+
+static void fillSpan(Color4b* dst, int count, Color4b col) {
+    __m256i v = splat(col);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    if (i < count) {
+        __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), idx);
+        _mm256_maskstore_epi32((int*)(dst + i), tail, v);
+    }
+}
+
+static void fillRect(Color4b* dst, int stride, int width, int height, Color4b col) {
+    for (int y = 0; y < height; ++y) {
+        fillSpan(dst + y * stride, width, col);
+    }
+}
+
+static void maskedBlit(Color4b* dst, const Color4b* src, const uint8_t* mask, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(mask + i)));
+        __m256i take = _mm256_xor_si256(_mm256_cmpeq_epi32(m, zero), _mm256_set1_epi32(-1));
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_maskstore_epi32((int*)(dst + i), take, s);
+    }
+    for (; i < count; ++i) {
+        if (mask[i]) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+static void expandIndices(Color4b* dst, const uint8_t* src, const Color4b* palette, int count) {
+    const int* table = (const int*)palette;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32(table, idx, 4));
+    }
+    for (; i < count; ++i) {
+        dst[i] = palette[src[i]];
+    }
+}
+
+const Kernels* avx2Kernels() {
+    static const Kernels k = { "avx2", fillSpan, fillRect, maskedBlit, expandIndices };
+    return __builtin_cpu_supports("avx2") ? &k : nullptr;
+}
@@ -0,0 +1,57 @@
+#include "Kernels.hpp"
+
+#include <cstring>
+#include <immintrin.h>
+
+static __m512i splat(Color4b col) {
+    int v;
+    memcpy(&v, &col, sizeof(v));
+    return _mm512_set1_epi32(v);
+}
+
+static __mmask16 tailMask(int n) {
+    return (__mmask16)((1u << n) - 1);
+}
+
+static void fillSpan(Color4b* dst, int count, Color4b col) {
+    __m512i v = splat(col);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_si512(dst + i, v);
+    }
+    if (i < count) {
+        _mm512_mask_storeu_epi32(dst + i, tailMask(count - i), v);
+    }
+}
+
+static void fillRect(Color4b* dst, int stride, int width, int height, Color4b col) {
+    for (int y = 0; y < height; ++y) {
+        fillSpan(dst + y * stride, width, col);
+    }
+}
+
+static void maskedBlit(Color4b* dst, const Color4b* src, const uint8_t* mask, int count) {
+    int i = 0;
+    for (; i < count; i += 16) {
+        __mmask16 valid = count - i >= 16 ? (__mmask16)0xffff : tailMask(count - i);
+        __m128i m8 = _mm_maskz_loadu_epi8(valid, mask + i);
+        __m512i m = _mm512_maskz_cvtepu8_epi32(valid, m8);
+        __mmask16 take = _mm512_test_epi32_mask(m, m);
+        __m512i s = _mm512_maskz_loadu_epi32(take, src + i);
+        _mm512_mask_storeu_epi32(dst + i, take, s);
+    }
+}
+
+static void expandIndices(Color4b* dst, const uint8_t* src, const Color4b* palette, int count) {
+    for (int i = 0; i < count; i += 16) {
+        __mmask16 valid = count - i >= 16 ? (__mmask16)0xffff : tailMask(count - i);
+        __m512i idx = _mm512_maskz_cvtepu8_epi32(valid, _mm_maskz_loadu_epi8(valid, src + i));
+        __m512i px = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), valid, idx, palette, 4);
+        _mm512_mask_storeu_epi32(dst + i, valid, px);
+    }
+}
+
+const Kernels* avx512Kernels() {
+    static const Kernels k = { "avx512", fillSpan, fillRect, maskedBlit, expandIndices };
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") ? &k : nullptr;
+}
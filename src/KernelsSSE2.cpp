@@ -0,0 +1,68 @@
+#include "Kernels.hpp"
+
+#include <cstring>
+#include <emmintrin.h>
+
+static __m128i splat(Color4b col) {
+    int v;
+    memcpy(&v, &col, sizeof(v));
+    return _mm_set1_epi32(v);
+}
+
+static void fillSpan(Color4b* dst, int count, Color4b col) {
+    __m128i v = splat(col);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    for (; i < count; ++i) {
+        dst[i] = col;
+    }
+}
+
+static void fillRect(Color4b* dst, int stride, int width, int height, Color4b col) {
+    for (int y = 0; y < height; ++y) {
+        fillSpan(dst + y * stride, width, col);
+    }
+}
+
+static void maskedBlit(Color4b* dst, const Color4b* src, const uint8_t* mask, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int m4;
+        memcpy(&m4, mask + i, sizeof(m4));
+        __m128i m = _mm_cvtsi32_si128(m4);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m);
+        // All-ones lanes where the mask byte is zero keep the destination.
+        __m128i keep = _mm_cmpeq_epi32(m, zero);
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i r = _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s));
+        _mm_storeu_si128((__m128i*)(dst + i), r);
+    }
+    for (; i < count; ++i) {
+        if (mask[i]) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+// SSE2 has no gather, so the lookups stay scalar and only the stores are 16 bytes wide.
+static void expandIndices(Color4b* dst, const uint8_t* src, const Color4b* palette, int count) {
+    const int* table = (const int*)palette;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_setr_epi32(table[src[i]], table[src[i + 1]], table[src[i + 2]], table[src[i + 3]]);
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    for (; i < count; ++i) {
+        dst[i] = palette[src[i]];
+    }
+}
+
+const Kernels* sse2Kernels() {
+    static const Kernels k = { "sse2", fillSpan, fillRect, maskedBlit, expandIndices };
+    return __builtin_cpu_supports("sse2") ? &k : nullptr;
+}
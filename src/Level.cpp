@@ -0,0 +1,72 @@
+#include "Level.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+Level::Level(int width, int height) :
+    pacman(Point(400, 300)),
+    redGhost(Point(1400, 400), Color3f(1.f, 0.341f, 0.016f)),
+    greenGhost(Point(900, 600), Color3f(0.149f, 0.729f, 0.157f)),
+    blueGhost(Point(1000, 800), Color3f(0.341f, 0.675f, 1.f)) {
+    for (int i = 0; i < 30; ++i) {
+        int x = rand() % width;
+        int y = rand() % height;
+        coins.add(entity_coin, toFixed(Point(x, y)), toFixed(COIN_RAD), COIN_COLOR);
+    }
+
+    Point ps[] = {
+        Point(50, 100),
+        Point(1800, 100),
+        Point(1800, 900),
+        Point(200, 900),
+        Point(200, 600),
+        Point(50, 600),
+        Point(50, 100),
+    };
+    for (int i = 0; i + 1 < (int)(sizeof(ps) / sizeof(ps[0])); ++i) {
+        walls.emplace_back(ps[i], ps[i + 1]);
+    }
+}
+
+static int scaled(int v, float scale) {
+    return (int)std::lround(v * scale);
+}
+
+static Point scaled(const Point& p, float scale) {
+    return Point(scaled(p.x, scale), scaled(p.y, scale));
+}
+
+static int radius(const Box& b, float scale) {
+    return std::max(1, scaled(b.width() / 2, scale));
+}
+
+Level::Level(const Level& level, float scale) :
+    pacman(scaled(level.pacman.center(), scale), radius(level.pacman, scale)),
+    redGhost(scaled(level.redGhost.center(), scale), level.redGhost.getTintColor(), radius(level.redGhost, scale)),
+    greenGhost(scaled(level.greenGhost.center(), scale), level.greenGhost.getTintColor(), radius(level.greenGhost, scale)),
+    blueGhost(scaled(level.blueGhost.center(), scale), level.blueGhost.getTintColor(), radius(level.blueGhost, scale)) {
+    for (int i = 0; i < level.coins.size(); ++i) {
+        Point c = scaled(Point(roundFixed(level.coins.x[i]), roundFixed(level.coins.y[i])), scale);
+        int rad = std::max(1, scaled(roundFixed(level.coins.rad[i]), scale));
+        coins.add((EntityType)level.coins.type[i], toFixed(c), toFixed(rad), level.coins.color[i]);
+        coins.visible[i] = level.coins.visible[i];
+    }
+    for (const Wall& w : level.walls) {
+        walls.emplace_back(scaled(w.pmin, scale), scaled(w.pmax, scale));
+    }
+}
+
+void Level::fillPalette(Palette& palette) const {
+    Point origin(0, 0);
+    if (coins.size() > 0) {
+        palette.add(coins.color[0]);
+    }
+    if (!walls.empty()) {
+        palette.add(walls[0].getColor(origin));
+    }
+    palette.add(pacman.getColor(origin));
+    palette.addRamp(redGhost.getTintColor(), PALETTE_RAMP);
+    palette.addRamp(greenGhost.getTintColor(), PALETTE_RAMP);
+    palette.addRamp(blueGhost.getTintColor(), PALETTE_RAMP);
+}
@@ -1,67 +1,157 @@
 #include "Window.hpp"
-#include "Drawable.hpp"
+#include "FramePacer.hpp"
+#include "Level.hpp"
+#include "Options.hpp"
+#include "Profiler.hpp"
+#include "Renderer.hpp"
+#include "ResolutionController.hpp"
+#include "Simulation.hpp"
+#include "Trace.hpp"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+#include <cmath>
 #include <cstdio>
-#include <cstdlib>
 
-#include <vector>
+// Rebuilds the framebuffer, the level and the renderer for an internal resolution of
+// scale times the window size.
+static Framebuffer* setResolution(GLFWwindow* window, const Options& opts, const Level& level, float scale,
+    Level*& scaled, Renderer*& renderer) {
+    // Queued frames still point at the palette of the old renderer.
+    drainWindowPipeline(window);
+    delete renderer;
+    delete scaled;
+    renderer = nullptr;
+    scaled = nullptr;
+    int width = (int)std::lround(SCREEN_WIDTH * scale);
+    int height = (int)std::lround(SCREEN_HEIGHT * scale);
+    Framebuffer* fb = resizeWindowFramebuffer(window, width, height);
+    if (!fb) {
+        return nullptr;
+    }
+    scaled = new Level(level, scale);
+    renderer = new Renderer(opts, *fb, *scaled);
+    return fb;
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts, true)) {
+        return 1;
+    }
 
-int main() {
-    const int width = 1920;
-    const int height = 1080;
-    GLFWwindow* window = createWindow(width, height);
+    GLFWwindow* window = createWindow(SCREEN_WIDTH, SCREEN_HEIGHT, opts);
+    if (!window) {
+        return 1;
+    }
 
-    Pacman pacman(Point(400, 300));
-    Ghost redGhost(Point(1400, 400), Color3f(1.f, 0.341f, 0.016f));
-    Ghost greenGhost(Point(900, 600), Color3f(0.149f, 0.729f, 0.157f));
-    Ghost blueGhost(Point(1000, 800), Color3f(0.341f, 0.675f, 1.f));
-    std::vector<Coin> coins;
-    for (int i = 0; i < 30; ++i) {
-        int x = rand() % width;
-        int y = rand() % height;
-        coins.emplace_back(Point(x, y));
+    Level level(SCREEN_WIDTH, SCREEN_HEIGHT);
+    ResolutionController resolution(opts.targetMs, opts.scale);
+    Level* scaled = nullptr;
+    Renderer* renderer = nullptr;
+    Framebuffer* fb = setResolution(window, opts, level, resolution.getScale(), scaled, renderer);
+    if (!fb) {
+        destroyWindow(window);
+        return 1;
+    }
+    if (opts.format == format_palette) {
+        setWindowPalette(window, renderer->getPalette());
     }
+    if (opts.pipeline > 0 && !startWindowPipeline(window, opts.pipeline)) {
+        delete renderer;
+        delete scaled;
+        destroyWindow(window);
+        return 1;
+    }
+    Trace::setThreadName("main");
+    FramePacer pacer(opts.pacing, opts.fps);
+    {
+        // Joined at the end of this scope, before the window goes away: an idle loop
+        // sleeps in glfwWaitEvents and the simulation wakes it through GLFW.
+        Simulation sim(level, opts.idle ? glfwPostEmptyEvent : nullptr);
+        const int keys[] = { GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_DOWN };
 
-    Point ps[] = {
-        Point(50, 100),
-        Point(1800, 100),
-        Point(1800, 900),
-        Point(200, 900),
-        Point(200, 600),
-        Point(50, 600),
-        Point(50, 100),
-    };
-    Wall walls[] = {
-        Wall(ps[0], ps[1]),
-        Wall(ps[1], ps[2]),
-        Wall(ps[2], ps[3]),
-        Wall(ps[3], ps[4]),
-        Wall(ps[4], ps[5]),
-        Wall(ps[5], ps[6]),
-    };
+        int frame = 0;
+        while (!glfwWindowShouldClose(window) && (opts.frames == 0 || frame < opts.frames)) {
+            {
+                TRACE_ZONE("events");
+                if (opts.idle && isWindowHidden(window)) {
+                    // The simulation is paused as well, or every tick it publishes would wake us.
+                    sim.setPaused(true);
+                    glfwWaitEvents();
+                    continue;
+                }
+                sim.setPaused(false);
+                if (!opts.idle) {
+                    glfwPollEvents();
+                } else if (fb->getDirty().empty()) {
+                    // Changes made outside of event handling are picked up within IDLE_TIMEOUT.
+                    glfwWaitEventsTimeout(IDLE_TIMEOUT);
+                } else {
+                    glfwPollEvents();
+                }
+            }
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                glfwSetWindowShouldClose(window, true);
+            }
+            for (int i = 0; i < 4; ++i) {
+                if (glfwGetKey(window, keys[i]) == GLFW_PRESS) {
+                    sim.setDirection((Direction)i);
+                }
+            }
+            // Idle loops only wake up for new snapshots, so they show them as they are rather
+            // than blend towards them.
+            sim.update();
+            const Snapshot& snapshot = sim.getSnapshot();
+            float blend = opts.idle ? 1.f : getBlend(snapshot, std::chrono::steady_clock::now());
+            applySnapshot(snapshot, blend, *scaled, renderer->getScene(), resolution.getScale());
+            // Every change to the scene marks the framebuffer dirty, so a clean one with no
+            // input to react to would be redrawn and presented exactly as it is.
+            bool events = takeWindowEvents(window);
+            if (opts.idle && !events && fb->getDirty().empty()) {
+                continue;
+            }
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window, true);
-        }
-        Framebuffer* fb = getWindowFramebuffer(window);
-        fb->clear();
-        for (const Coin& c : coins) {
-            fb->draw(c);
-        }
-        for (const Wall& w : walls) {
-            fb->draw(w);
+            TRACE_ZONE("frame");
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            {
+                TRACE_ZONE("render");
+                renderer->render();
+            }
+            std::chrono::duration<double, std::milli> renderTime = std::chrono::steady_clock::now() - start;
+            if (opts.dumpDir) {
+                TRACE_ZONE("dump");
+                if (!dumpFrame(*fb, opts.dumpDir, frame)) {
+                    break;
+                }
+            }
+            displayWindowFramebuffer(window);
+            fb->clearDirty();
+            pacer.endFrame();
+            Profiler::get().endFrame();
+
+            if (resolution.update(renderTime.count())) {
+                fb = setResolution(window, opts, level, resolution.getScale(), scaled, renderer);
+                if (!fb) {
+                    break;
+                }
+                applySnapshot(snapshot, blend, *scaled, renderer->getScene(), resolution.getScale());
+            }
+            ++frame;
         }
-        fb->draw(pacman);
-        fb->draw(redGhost);
-        fb->draw(greenGhost);
-        fb->draw(blueGhost);
-        displayWindowFramebuffer(window);
     }
 
-    return 0;
+    pacer.print();
+    if (opts.targetMs > 0.f && fb) {
+        printf("scale %.2f: %dx%d\n", resolution.getScale(), fb->getWidth(), fb->getHeight());
+    }
+    if (opts.stats) {
+        Profiler::get().print();
+    }
+    delete renderer;
+    delete scaled;
+    destroyWindow(window);
+    return Trace::write() ? 0 : 1;
 }
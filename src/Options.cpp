@@ -0,0 +1,183 @@
+#include "Options.hpp"
+#include "Config.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+Options::Options() :
+    mode(render_retained), upload(upload_pbo), format(format_rgba8), pacing(pacing_vsync), fps(60), scale(1.f),
+    upscale(upscale_nearest), targetMs(0.f), threads(std::thread::hardware_concurrency()), frames(0), dumpDir(nullptr),
+    hud(false), stats(false), idle(false), pipeline(0) {
+    if (threads < 1) {
+        threads = 1;
+    }
+}
+
+static void printUsage(const char* prog, bool window) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --immediate      clear and redraw the whole scene every frame\n"
+        "  --tiled          redraw every frame in screen tiles on a pool of threads\n"
+        "  --threads N      worker threads for --tiled (default: all cores)\n"
+        "  --frames N       stop after N frames\n"
+        "  --dump DIR       write every frame to DIR/frame_NNNNN.ppm\n"
+        "  --hud            show per-phase frame timings\n"
+        "  --stats          print per-phase frame timings on exit\n"
+        "  --pacing MODE    vsync, adaptive, uncapped or limit (default: vsync)\n"
+        "  --fps N          frame rate of --pacing limit (default: 60)\n"
+        "  --scale F        render at F times the window resolution, 0.25 to 1 (default: 1)\n",
+        prog);
+    if (window) {
+        fprintf(stderr,
+            "  --upload MODE    texture upload: direct or pbo (default: pbo)\n"
+            "  --format FORMAT  texture format: rgba8, rgb10a2 or palette (default: rgba8)\n"
+            "  --upscale FILTER nearest or sharp (sharp bilinear) (default: nearest)\n"
+            "  --target-ms MS   adjust the scale to keep rendering under MS per frame\n"
+            "  --idle           redraw only on changes or input, pause while minimized\n"
+            "  --pipeline N     upload and present on a separate thread, up to N frames behind (1-4)\n");
+    }
+}
+
+// Options that only mean something when presenting to a window.
+static bool isWindowOption(const char* arg) {
+    const char* names[] = { "--upload", "--format", "--upscale", "--target-ms", "--idle", "--pipeline" };
+    for (const char* name : names) {
+        if (strcmp(arg, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseInt(const char* s, int minValue, int& out) {
+    char* end;
+    long v = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v < minValue) {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+static bool parseFloat(const char* s, float minValue, float maxValue, float& out) {
+    char* end;
+    float v = strtof(s, &end);
+    if (*s == '\0' || *end != '\0' || !(v >= minValue && v <= maxValue)) {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& opts, bool window) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!window && isWindowOption(arg)) {
+            fprintf(stderr, "%s needs a window\n", arg);
+            return false;
+        }
+        if (strcmp(arg, "--immediate") == 0) {
+            opts.mode = render_immediate;
+        } else if (strcmp(arg, "--tiled") == 0) {
+            opts.mode = render_tiled;
+        } else if (strcmp(arg, "--threads") == 0 && i + 1 < argc) {
+            if (!parseInt(argv[++i], 1, opts.threads)) {
+                fprintf(stderr, "Invalid thread count: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--frames") == 0 && i + 1 < argc) {
+            if (!parseInt(argv[++i], 1, opts.frames)) {
+                fprintf(stderr, "Invalid frame count: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--dump") == 0 && i + 1 < argc) {
+            opts.dumpDir = argv[++i];
+        } else if (strcmp(arg, "--hud") == 0) {
+#ifndef ENABLE_PROFILER
+            fprintf(stderr, "--hud needs a build with ENABLE_PROFILER\n");
+            return false;
+#endif
+            opts.hud = true;
+        } else if (strcmp(arg, "--pipeline") == 0 && i + 1 < argc) {
+            if (!parseInt(argv[++i], 1, opts.pipeline) || opts.pipeline > PIPELINE_MAX_FRAMES) {
+                fprintf(stderr, "Invalid pipeline depth: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--idle") == 0) {
+            opts.idle = true;
+        } else if (strcmp(arg, "--stats") == 0) {
+#ifndef ENABLE_PROFILER
+            fprintf(stderr, "--stats needs a build with ENABLE_PROFILER\n");
+            return false;
+#endif
+            opts.stats = true;
+        } else if (strcmp(arg, "--upload") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "direct") == 0) {
+                opts.upload = upload_direct;
+            } else if (strcmp(mode, "pbo") == 0) {
+                opts.upload = upload_pbo;
+            } else {
+                fprintf(stderr, "Invalid upload mode: %s\n", mode);
+                return false;
+            }
+        } else if (strcmp(arg, "--format") == 0 && i + 1 < argc) {
+            const char* format = argv[++i];
+            if (strcmp(format, "rgba8") == 0) {
+                opts.format = format_rgba8;
+            } else if (strcmp(format, "rgb10a2") == 0) {
+                opts.format = format_rgb10a2;
+            } else if (strcmp(format, "palette") == 0) {
+                opts.format = format_palette;
+            } else {
+                fprintf(stderr, "Invalid texture format: %s\n", format);
+                return false;
+            }
+        } else if (strcmp(arg, "--pacing") == 0 && i + 1 < argc) {
+            const char* pacing = argv[++i];
+            if (strcmp(pacing, "vsync") == 0) {
+                opts.pacing = pacing_vsync;
+            } else if (strcmp(pacing, "adaptive") == 0) {
+                opts.pacing = pacing_adaptive;
+            } else if (strcmp(pacing, "uncapped") == 0) {
+                opts.pacing = pacing_uncapped;
+            } else if (strcmp(pacing, "limit") == 0) {
+                opts.pacing = pacing_limit;
+            } else {
+                fprintf(stderr, "Invalid pacing mode: %s\n", pacing);
+                return false;
+            }
+        } else if (strcmp(arg, "--scale") == 0 && i + 1 < argc) {
+            if (!parseFloat(argv[++i], RES_MIN_SCALE, 1.f, opts.scale)) {
+                fprintf(stderr, "Invalid scale: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--upscale") == 0 && i + 1 < argc) {
+            const char* filter = argv[++i];
+            if (strcmp(filter, "nearest") == 0) {
+                opts.upscale = upscale_nearest;
+            } else if (strcmp(filter, "sharp") == 0) {
+                opts.upscale = upscale_sharp;
+            } else {
+                fprintf(stderr, "Invalid upscale filter: %s\n", filter);
+                return false;
+            }
+        } else if (strcmp(arg, "--target-ms") == 0 && i + 1 < argc) {
+            if (!parseFloat(argv[++i], 0.f, 1000.f, opts.targetMs)) {
+                fprintf(stderr, "Invalid target frame time: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--fps") == 0 && i + 1 < argc) {
+            if (!parseInt(argv[++i], 1, opts.fps)) {
+                fprintf(stderr, "Invalid frame rate: %s\n", argv[i]);
+                return false;
+            }
+        } else {
+            printUsage(argv[0], window);
+            return false;
+        }
+    }
+    return true;
+}
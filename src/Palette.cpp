@@ -0,0 +1,59 @@
+#include "Palette.hpp"
+
+Palette::Palette() : size(0) {
+    add(Color3f(0.f, 0.f, 0.f));
+}
+
+uint8_t Palette::add(Color3f col) {
+    Color4b c = convertColor<Color4b>(col);
+    for (int i = 0; i < size; ++i) {
+        if (colors[i].r == c.r && colors[i].g == c.g && colors[i].b == c.b) {
+            return i;
+        }
+    }
+    if (size == 256) {
+        return nearest(c);
+    }
+    colors[size] = c;
+    return size++;
+}
+
+void Palette::addRamp(Color3f col, int count) {
+    for (int i = 1; i <= count; ++i) {
+        float t = (float)i / count;
+        add(Color3f(col.r * t, col.g * t, col.b * t));
+    }
+}
+
+uint8_t Palette::nearest(Color4b col) const {
+    int best = 0;
+    int bestDist = 1 << 30;
+    for (int i = 0; i < size; ++i) {
+        int dr = colors[i].r - col.r;
+        int dg = colors[i].g - col.g;
+        int db = colors[i].b - col.b;
+        int dist = dr * dr + dg * dg + db * db;
+        if (dist < bestDist) {
+            best = i;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+void Palette::build() {
+    lut.resize(1 << 16);
+    for (int i = 0; i < (1 << 16); ++i) {
+        // The 5:6:5 color expanded back to 8 bits.
+        int r = i >> 11;
+        int g = (i >> 5) & 63;
+        int b = i & 31;
+        lut[i] = nearest(Color4b(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2));
+    }
+}
+
+void Palette::quantize(const Color4b* src, uint8_t* dst, int count) const {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = lookup(src[i]);
+    }
+}
@@ -0,0 +1,180 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+static const char* phaseNames[phase_count] = {
+    "clear", "background", "coins", "walls", "pacman", "ghosts", "dynamic", "tiles", "upload", "swap"
+};
+
+const char* getPhaseName(Phase phase) {
+    return phaseNames[phase];
+}
+
+// 3x5 glyphs, upper case only, one row per entry with the leftmost pixel in the highest bit.
+struct Glyph {
+    char c;
+    unsigned char rows[5];
+};
+
+static const Glyph font[] = {
+    { '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } }, { '2', { 7, 1, 7, 4, 7 } },
+    { '3', { 7, 1, 7, 1, 7 } }, { '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } },
+    { '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 1, 1, 1 } }, { '8', { 7, 5, 7, 5, 7 } },
+    { '9', { 7, 5, 7, 1, 7 } }, { '.', { 0, 0, 0, 0, 2 } }, { ':', { 0, 2, 0, 2, 0 } },
+    { '-', { 0, 0, 7, 0, 0 } }, { '/', { 1, 1, 2, 4, 4 } }, { '%', { 5, 1, 2, 4, 5 } },
+    { 'A', { 2, 5, 7, 5, 5 } }, { 'B', { 6, 5, 6, 5, 6 } }, { 'C', { 3, 4, 4, 4, 3 } },
+    { 'D', { 6, 5, 5, 5, 6 } }, { 'E', { 7, 4, 6, 4, 7 } }, { 'F', { 7, 4, 6, 4, 4 } },
+    { 'G', { 3, 4, 5, 5, 3 } }, { 'H', { 5, 5, 7, 5, 5 } }, { 'I', { 7, 2, 2, 2, 7 } },
+    { 'J', { 1, 1, 1, 5, 2 } }, { 'K', { 5, 5, 6, 5, 5 } }, { 'L', { 4, 4, 4, 4, 7 } },
+    { 'M', { 5, 7, 7, 5, 5 } }, { 'N', { 6, 5, 5, 5, 5 } }, { 'O', { 2, 5, 5, 5, 2 } },
+    { 'P', { 6, 5, 6, 4, 4 } }, { 'Q', { 2, 5, 5, 6, 3 } }, { 'R', { 6, 5, 6, 5, 5 } },
+    { 'S', { 3, 4, 2, 1, 6 } }, { 'T', { 7, 2, 2, 2, 2 } }, { 'U', { 5, 5, 5, 5, 7 } },
+    { 'V', { 5, 5, 5, 5, 2 } }, { 'W', { 5, 5, 7, 7, 5 } }, { 'X', { 5, 5, 2, 5, 5 } },
+    { 'Y', { 5, 5, 2, 2, 2 } }, { 'Z', { 7, 1, 2, 4, 7 } },
+};
+
+const int HUD_SCALE = 2;
+const int HUD_ADVANCE = 4 * HUD_SCALE;
+const int HUD_LINE = 7 * HUD_SCALE;
+const int HUD_MARGIN = 8;
+const int HUD_COLUMNS = 31;
+const Color3f HUD_TEXT(1.f, 1.f, 1.f);
+const Color3f HUD_TOTAL(1.f, 0.937f, 0.f);
+const Color3f HUD_BACKGROUND(0.1f, 0.1f, 0.1f);
+
+// y is the top row of the text. Framebuffer rows grow upwards on screen.
+static void drawText(Framebuffer& fb, int x, int y, const char* text, Color3f col) {
+    for (; *text; ++text, x += HUD_ADVANCE) {
+        const Glyph* glyph = nullptr;
+        for (const Glyph& g : font) {
+            if (g.c == toupper(*text)) {
+                glyph = &g;
+                break;
+            }
+        }
+        if (!glyph) {
+            continue;
+        }
+        for (int gy = 0; gy < 5; ++gy) {
+            for (int gx = 0; gx < 3; ++gx) {
+                if (glyph->rows[gy] & (4 >> gx)) {
+                    int px = x + gx * HUD_SCALE;
+                    int py = y - gy * HUD_SCALE;
+                    fb.fill(Box(Point(px, py - HUD_SCALE + 1), Point(px + HUD_SCALE - 1, py)), col);
+                }
+            }
+        }
+    }
+}
+
+Profiler& Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : next(0), count(0), frameStart(std::chrono::steady_clock::now()) {
+    memset(current, 0, sizeof(current));
+}
+
+void Profiler::record(Phase phase, double ms) {
+    current[phase] += ms;
+}
+
+void Profiler::endFrame() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = now - frameStart;
+    frameStart = now;
+
+    memcpy(samples[next], current, sizeof(current));
+    memset(current, 0, sizeof(current));
+    frameTimes[next] = elapsed.count();
+    next = (next + 1) % PROFILER_FRAMES;
+    count = std::min(count + 1, PROFILER_FRAMES);
+}
+
+double Profiler::average(Phase phase) const {
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += samples[i][phase];
+    }
+    return count ? sum / count : 0.0;
+}
+
+double Profiler::percentile(Phase phase, float p) const {
+    return percentile(&samples[0][phase], phase_count, p);
+}
+
+double Profiler::averageFrame() const {
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += frameTimes[i];
+    }
+    return count ? sum / count : 0.0;
+}
+
+double Profiler::percentileFrame(float p) const {
+    return percentile(frameTimes, 1, p);
+}
+
+double Profiler::percentile(const float* values, int stride, float p) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    float sorted[PROFILER_FRAMES];
+    for (int i = 0; i < count; ++i) {
+        sorted[i] = values[i * stride];
+    }
+    int k = std::min(count - 1, (int)(p * count));
+    std::nth_element(sorted, sorted + k, sorted + count);
+    return sorted[k];
+}
+
+Box Profiler::getHudBounds(const Framebuffer& fb) const {
+    int lines = phase_count + 2;
+    int top = fb.getHeight() - 1 - HUD_MARGIN;
+    return Box(Point(HUD_MARGIN, top - lines * HUD_LINE - 2 * HUD_SCALE),
+        Point(HUD_MARGIN + HUD_COLUMNS * HUD_ADVANCE + 2 * HUD_SCALE, top));
+}
+
+void Profiler::print() const {
+    printf("%-10s %8s %8s %8s\n", "ms", "avg", "p50", "p99");
+    for (int i = 0; i < phase_count; ++i) {
+        Phase phase = (Phase)i;
+        if (percentile(phase, 1.f) > 0.0) {
+            printf("%-10s %8.3f %8.3f %8.3f\n", phaseNames[i], average(phase), percentile(phase, 0.5f),
+                percentile(phase, 0.99f));
+        }
+    }
+    printf("%-10s %8.3f %8.3f %8.3f\n", "frame", averageFrame(), percentileFrame(0.5f), percentileFrame(0.99f));
+}
+
+void Profiler::addHudColors(Palette& palette) const {
+    palette.add(HUD_TEXT);
+    palette.add(HUD_TOTAL);
+    palette.add(HUD_BACKGROUND);
+}
+
+void Profiler::drawHud(Framebuffer& fb) const {
+    Box bounds = getHudBounds(fb);
+    fb.fill(bounds, HUD_BACKGROUND);
+
+    int x = bounds.xmin() + 2 * HUD_SCALE;
+    int y = bounds.ymax() - 2 * HUD_SCALE;
+    char line[64];
+    snprintf(line, sizeof(line), "%-10s %6s %6s %6s", "MS", "AVG", "P50", "P99");
+    drawText(fb, x, y, line, HUD_TEXT);
+    y -= HUD_LINE;
+    for (int i = 0; i < phase_count; ++i) {
+        Phase phase = (Phase)i;
+        snprintf(line, sizeof(line), "%-10s %6.2f %6.2f %6.2f", phaseNames[i], average(phase),
+            percentile(phase, 0.5f), percentile(phase, 0.99f));
+        drawText(fb, x, y, line, HUD_TEXT);
+        y -= HUD_LINE;
+    }
+    snprintf(line, sizeof(line), "%-10s %6.2f %6.2f %6.2f", "frame", averageFrame(), percentileFrame(0.5f),
+        percentileFrame(0.99f));
+    drawText(fb, x, y, line, HUD_TOTAL);
+}
@@ -0,0 +1,126 @@
+#include "Renderer.hpp"
+#include "Profiler.hpp"
+
+#include <cstdio>
+#include <vector>
+
+Renderer::Renderer(const Options& opts, Framebuffer& fb, Level& level) :
+    mode(opts.mode), hud(opts.hud), fb(fb), level(level), scene(fb), tiles(nullptr) {
+    scene.setEntities(&level.coins);
+    for (Wall& w : level.walls) {
+        scene.add(&w, layer_static);
+    }
+    scene.add(&level.pacman);
+    scene.add(&level.redGhost);
+    scene.add(&level.greenGhost);
+    scene.add(&level.blueGhost);
+
+    if (mode == render_tiled) {
+        tiles = new TileRenderer(opts.threads);
+    }
+
+    level.fillPalette(palette);
+    if (hud) {
+        Profiler::get().addHudColors(palette);
+    }
+    palette.build();
+    fb.setPalette(&palette);
+}
+
+Renderer::~Renderer() {
+    delete tiles;
+}
+
+const Palette& Renderer::getPalette() const {
+    return palette;
+}
+
+void Renderer::render() {
+    if (hud) {
+        // Restore what the previous overlay covered.
+        fb.addDirty(Profiler::get().getHudBounds(fb));
+    }
+
+    switch (mode) {
+        case render_retained:
+            scene.render();
+            break;
+        case render_tiled: {
+            PROFILE_SCOPE(phase_tiles);
+            tiles->render(fb, scene.getEntities(), scene.getElements());
+            fb.addDirty(fb.getBounds());
+            break;
+        }
+        case render_immediate:
+            renderImmediate();
+            fb.addDirty(fb.getBounds());
+            break;
+    }
+
+#ifdef ENABLE_PROFILER
+    if (hud) {
+        Profiler::get().drawHud(fb);
+    }
+#endif
+}
+
+void Renderer::renderImmediate() {
+    {
+        PROFILE_SCOPE(phase_clear);
+        fb.clear();
+    }
+    {
+        PROFILE_SCOPE(phase_coins);
+        drawEntities(fb, level.coins, fb.getBounds());
+    }
+    {
+        PROFILE_SCOPE(phase_walls);
+        fb.drawBatch(level.walls.data(), level.walls.data() + level.walls.size());
+    }
+    {
+        PROFILE_SCOPE(phase_pacman);
+        fb.draw(level.pacman);
+    }
+    PROFILE_SCOPE(phase_ghosts);
+    fb.draw(level.redGhost);
+    fb.draw(level.greenGhost);
+    fb.draw(level.blueGhost);
+}
+
+Scene& Renderer::getScene() {
+    return scene;
+}
+
+bool dumpFrame(const Framebuffer& fb, const char* dir, int frame) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/frame_%05d.ppm", dir, frame);
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    int width = fb.getWidth();
+    int height = fb.getHeight();
+    std::vector<Color4b> pixels(width * height);
+    fb.readColors(pixels.data(), fb.getBounds());
+    std::vector<unsigned char> rgb(width * height * 3);
+    // Row 0 is the bottom of the window, PPM starts at the top.
+    for (int y = 0; y < height; ++y) {
+        const Color4b* src = &pixels[(height - 1 - y) * width];
+        unsigned char* dst = &rgb[3 * y * width];
+        for (int x = 0; x < width; ++x) {
+            dst[3 * x] = src[x].r;
+            dst[3 * x + 1] = src[x].g;
+            dst[3 * x + 2] = src[x].b;
+        }
+    }
+
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    bool ok = fwrite(rgb.data(), 1, rgb.size(), fp) == rgb.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
@@ -0,0 +1,46 @@
+#include "ResolutionController.hpp"
+#include "Config.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController(float targetMs, float scale) :
+    targetMs(targetMs), scale(scale), average(0.0), frames(0) {}
+
+bool ResolutionController::update(double ms) {
+    if (targetMs <= 0.f) {
+        return false;
+    }
+    // The first frame at a new scale draws everything and is not representative.
+    if (frames++ == 0) {
+        return false;
+    }
+    average = frames == 2 ? ms : average + (ms - average) * 0.1;
+    if (frames < RES_INTERVAL) {
+        return false;
+    }
+
+    float next = scale;
+    if (average > targetMs) {
+        // Jump straight to the scale that is predicted to fit.
+        next = std::floor(scale * std::sqrt(targetMs / average) / RES_STEP) * RES_STEP;
+    } else {
+        // Step up only when the predicted time stays clearly below the target.
+        float up = scale + RES_STEP;
+        if (average * (up * up) / (scale * scale) < targetMs * RES_HEADROOM) {
+            next = up;
+        }
+    }
+    next = std::min(1.f, std::max(RES_MIN_SCALE, next));
+    if (std::fabs(next - scale) < RES_STEP / 2) {
+        frames = RES_INTERVAL;
+        return false;
+    }
+    scale = next;
+    frames = 0;
+    return true;
+}
+
+float ResolutionController::getScale() const {
+    return scale;
+}
@@ -0,0 +1,115 @@
+#include "Scene.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+Scene::Scene(Framebuffer& fb) : fb(fb), background(fb.getWidth(), fb.getHeight()), staticCount(0),
+    entities(nullptr), binsStale(false) {
+    fb.addDirty(fb.getBounds());
+    background.addDirty(background.getBounds());
+}
+
+void Scene::add(DrawableBox* element, Layer layer) {
+    if (layer == layer_static) {
+        elements.insert(elements.begin() + staticCount, element);
+        ++staticCount;
+    } else {
+        elements.push_back(element);
+    }
+    invalidate(element);
+}
+
+void Scene::move(DrawableBox* element, int dx, int dy) {
+    invalidate(element);
+    element->moveBy(dx, dy);
+    invalidate(element);
+}
+
+void Scene::moveTo(DrawableBox* element, const FixedPoint& pos) {
+    invalidate(element);
+    element->setPosition(pos);
+    invalidate(element);
+}
+
+void Scene::setEntities(Entities* e) {
+    if (entities) {
+        invalidateStatic(fb.getBounds());
+    }
+    entities = e;
+    binsStale = true;
+    if (entities) {
+        invalidateStatic(fb.getBounds());
+    }
+}
+
+void Scene::hideEntity(int id) {
+    if (entities->visible[id]) {
+        entities->visible[id] = 0;
+        invalidateStatic(entities->getBounds(id));
+    }
+}
+
+void Scene::render() {
+    renderBackground();
+    renderDirty();
+}
+
+void Scene::renderBackground() {
+    PROFILE_SCOPE(phase_background);
+    background.setPalette(fb.getPalette());
+    if (entities && binsStale) {
+        entityBins.build(*entities, background.getWidth(), background.getHeight());
+        binsStale = false;
+    }
+    for (const Box& rect : background.getDirty()) {
+        background.clear(rect);
+        if (entities) {
+            drawEntities(background, *entities, entityBins, rect);
+        }
+        for (size_t i = 0; i < staticCount; ++i) {
+            if (elements[i]->overlaps(rect)) {
+                background.draw(*elements[i], rect);
+            }
+        }
+    }
+    background.clearDirty();
+}
+
+void Scene::renderDirty() {
+    for (const Box& rect : fb.getDirty()) {
+        {
+            PROFILE_SCOPE(phase_clear);
+            fb.copy(background, rect);
+        }
+        PROFILE_SCOPE(phase_dynamic);
+        for (size_t i = staticCount; i < elements.size(); ++i) {
+            if (elements[i]->overlaps(rect)) {
+                fb.draw(*elements[i], rect);
+            }
+        }
+    }
+}
+
+const std::vector<DrawableBox*>& Scene::getElements() const {
+    return elements;
+}
+
+const Entities* Scene::getEntities() const {
+    return entities;
+}
+
+bool Scene::isStatic(const DrawableBox* element) const {
+    return std::find(elements.begin(), elements.begin() + staticCount, element) != elements.begin() + staticCount;
+}
+
+void Scene::invalidate(const DrawableBox* element) {
+    if (isStatic(element)) {
+        background.addDirty(*element);
+    }
+    fb.addDirty(*element);
+}
+
+void Scene::invalidateStatic(const Box& rect) {
+    background.addDirty(rect);
+    fb.addDirty(rect);
+}
@@ -0,0 +1,209 @@
+#include "Simulation.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static Snapshot makeSnapshot(const Level& level) {
+    Snapshot s;
+    s.tick = 0;
+    s.time = std::chrono::steady_clock::now();
+    s.current.pacman = level.pacman.center();
+    s.current.ghosts[0] = level.redGhost.center();
+    s.current.ghosts[1] = level.greenGhost.center();
+    s.current.ghosts[2] = level.blueGhost.center();
+    s.previous = s.current;
+    s.direction = level.pacman.getDirection();
+    s.eaten.assign(level.coins.size(), false);
+    return s;
+}
+
+static std::chrono::steady_clock::duration getTickPeriod() {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / SIM_HZ;
+}
+
+static Point offset(const Point& p, Direction dir, int dist) {
+    switch (dir) {
+        case dir_left:
+            return Point(p.x - dist, p.y);
+        case dir_right:
+            return Point(p.x + dist, p.y);
+        case dir_up:
+            return Point(p.x, p.y + dist);
+        case dir_down:
+            return Point(p.x, p.y - dist);
+    }
+    return p;
+}
+
+Simulation::Simulation(const Level& level, void (*wake)()) :
+    state(makeSnapshot(level)), snapshots(state), coins(level.coins), pacmanRad(level.pacman.width() / 2),
+    ghostRad(level.redGhost.width() / 2), rng(1), input(-1), wake(wake), paused(false), stop(false) {
+    for (const Wall& w : level.walls) {
+        walls.push_back(w);
+    }
+    for (Direction& d : ghostDirs) {
+        d = (Direction)(rng() % 4);
+    }
+    thread = std::thread(&Simulation::run, this);
+}
+
+Simulation::~Simulation() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void Simulation::setDirection(Direction dir) {
+    input.store(dir, std::memory_order_relaxed);
+}
+
+void Simulation::setPaused(bool paused) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (this->paused == paused) {
+            return;
+        }
+        this->paused = paused;
+    }
+    cv.notify_one();
+}
+
+bool Simulation::update() {
+    return snapshots.update();
+}
+
+const Snapshot& Simulation::getSnapshot() const {
+    return snapshots.getFront();
+}
+
+void Simulation::run() {
+    typedef std::chrono::steady_clock Clock;
+    Trace::setThreadName("simulation");
+    Clock::duration period = getTickPeriod();
+    Clock::time_point next = Clock::now();
+    while (!stop.load(std::memory_order_relaxed)) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (paused) {
+                cv.wait(lock, [this] { return !paused || stop; });
+                next = Clock::now();
+                continue;
+            }
+        }
+        if (Clock::now() - next > SIM_MAX_CATCHUP * period) {
+            // Stalled for too long, skip the missed ticks rather than fast forward.
+            next = Clock::now();
+        }
+        bool changed;
+        {
+            TRACE_ZONE("tick");
+            changed = step();
+        }
+        if (changed) {
+            state.time = next;
+            snapshots.getBack() = state;
+            snapshots.publish();
+            if (wake) {
+                wake();
+            }
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+bool Simulation::blocked(const Point& center, int rad) const {
+    Box box(center, rad);
+    if (box.xmin() < 0 || box.ymin() < 0 || box.xmax() >= SCREEN_WIDTH || box.ymax() >= SCREEN_HEIGHT) {
+        return true;
+    }
+    for (const Box& w : walls) {
+        if (box.overlaps(w)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Simulation::step() {
+    bool changed = false;
+    state.previous = state.current;
+    int dir = input.load(std::memory_order_relaxed);
+    if (dir >= 0) {
+        if (state.direction != dir) {
+            state.direction = (Direction)dir;
+            changed = true;
+        }
+        Point next = offset(state.current.pacman, state.direction, PACMAN_SPEED);
+        if (!blocked(next, pacmanRad)) {
+            state.current.pacman = next;
+            changed = true;
+        }
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        Point next = offset(state.current.ghosts[i], ghostDirs[i], GHOST_SPEED);
+        // Turn now and then, and whenever the way is blocked.
+        for (int tries = 0; tries < 4 && (rng() % GHOST_TURN_TICKS == 0 || blocked(next, ghostRad)); ++tries) {
+            ghostDirs[i] = (Direction)(rng() % 4);
+            next = offset(state.current.ghosts[i], ghostDirs[i], GHOST_SPEED);
+        }
+        if (!blocked(next, ghostRad)) {
+            state.current.ghosts[i] = next;
+            changed = true;
+        }
+    }
+
+    hits.clear();
+    collideEntities(coins, entity_coin, toFixed(state.current.pacman), toFixed(pacmanRad), hits);
+    for (int id : hits) {
+        coins.visible[id] = 0;
+        state.eaten[id] = true;
+        changed = true;
+    }
+
+    if (changed) {
+        ++state.tick;
+    }
+    return changed;
+}
+
+float getBlend(const Snapshot& snapshot, std::chrono::steady_clock::time_point now) {
+    float t = std::chrono::duration<float>(now - snapshot.time) / getTickPeriod();
+    return std::min(1.f, std::max(0.f, t));
+}
+
+static Fixed blend(int from, int to, float t, float scale) {
+    return toFixed((from + (to - from) * t) * scale);
+}
+
+static void moveTo(Scene& scene, DrawableBox& element, const Point& from, const Point& to, float t, float scale) {
+    FixedPoint pos(blend(from.x, to.x, t, scale), blend(from.y, to.y, t, scale));
+    if (pos != element.getPosition()) {
+        scene.moveTo(&element, pos);
+    }
+}
+
+void applySnapshot(const Snapshot& snapshot, float blend, Level& level, Scene& scene, float scale) {
+    if (level.pacman.getDirection() != snapshot.direction) {
+        level.pacman.setDirection(snapshot.direction);
+        scene.move(&level.pacman, 0, 0);
+    }
+    const Actors& from = snapshot.previous;
+    const Actors& to = snapshot.current;
+    moveTo(scene, level.pacman, from.pacman, to.pacman, blend, scale);
+    moveTo(scene, level.redGhost, from.ghosts[0], to.ghosts[0], blend, scale);
+    moveTo(scene, level.greenGhost, from.ghosts[1], to.ghosts[1], blend, scale);
+    moveTo(scene, level.blueGhost, from.ghosts[2], to.ghosts[2], blend, scale);
+    for (int i = 0; i < (int)snapshot.eaten.size() && i < level.coins.size(); ++i) {
+        if (snapshot.eaten[i]) {
+            // A no-op for coins already hidden, so a freshly built level catches up.
+            scene.hideEntity(i);
+        }
+    }
+}
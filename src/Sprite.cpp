@@ -0,0 +1,51 @@
+#include "Sprite.hpp"
+
+Sprite::Sprite(const Bitmap& src, int width, int height, float threshold) :
+    width(width), height(height), mask(width * height), threshold(threshold) {
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float u = (float)x / (width - 1);
+            float v = (float)y / (height - 1);
+            float alpha = src.sample(u, v).intensity();
+            mask[y * width + x] = alpha * 255.f + 0.5f;
+        }
+    }
+}
+
+const Sprite::Tint& Sprite::getTint(Color3f color) {
+    for (const Tint& t : tints) {
+        if (t.color.r == color.r && t.color.g == color.g && t.color.b == color.b) {
+            return t;
+        }
+    }
+
+    tints.push_back(Tint());
+    Tint& t = tints.back();
+    t.color = color;
+    t.pixels.resize(width * height);
+    t.packed.resize(width * height);
+    t.covered.resize(width * height);
+    t.rowStart.reserve(height + 1);
+    for (int y = 0; y < height; ++y) {
+        t.rowStart.push_back(t.spans.size());
+        bool open = false;
+        for (int x = 0; x < width; ++x) {
+            float alpha = mask[y * width + x] / 255.f;
+            Color3f px(color.r * alpha, color.g * alpha, color.b * alpha);
+            bool covered = px.intensity() > threshold;
+            t.pixels[y * width + x] = px;
+            t.packed[y * width + x] = convertColor<Color4b>(px);
+            t.covered[y * width + x] = covered ? 255 : 0;
+
+            if (covered && !open) {
+                t.spans.push_back(Span(x, x));
+            }
+            if (covered) {
+                t.spans.back().x1 = x;
+            }
+            open = covered;
+        }
+    }
+    t.rowStart.push_back(t.spans.size());
+    return t;
+}
@@ -0,0 +1,114 @@
+#include "TileRenderer.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+
+TileRenderer::TileRenderer(int threads) :
+    frame(0), busyWorkers(0), stop(false), target(nullptr), entities(nullptr), elements(nullptr), tilesX(0),
+    tilesY(0), nextTile(0) {
+    // The calling thread renders tiles as well.
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(&TileRenderer::workerLoop, this);
+    }
+}
+
+TileRenderer::~TileRenderer() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    startCv.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void TileRenderer::render(Framebuffer& fb, const Entities* entities, const std::vector<DrawableBox*>& elements) {
+    bin(fb, entities, elements);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        target = &fb;
+        this->entities = entities;
+        this->elements = &elements;
+        nextTile = 0;
+        busyWorkers = workers.size();
+        ++frame;
+    }
+    startCv.notify_all();
+
+    renderTiles();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    doneCv.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void TileRenderer::bin(const Framebuffer& fb, const Entities* entities, const std::vector<DrawableBox*>& elements) {
+    TRACE_ZONE("bin");
+    tilesX = (fb.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (fb.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+    bins.resize(tilesX * tilesY);
+    for (std::vector<int>& b : bins) {
+        b.clear();
+    }
+
+    for (size_t i = 0; i < elements.size(); ++i) {
+        const DrawableBox* e = elements[i];
+        int tx0 = std::max(e->xmin() / TILE_SIZE, 0);
+        int tx1 = std::min(e->xmax() / TILE_SIZE, tilesX - 1);
+        int ty0 = std::max(e->ymin() / TILE_SIZE, 0);
+        int ty1 = std::min(e->ymax() / TILE_SIZE, tilesY - 1);
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) {
+                bins[ty * tilesX + tx].push_back(i);
+            }
+        }
+    }
+    if (entities) {
+        entityBins.build(*entities, fb.getWidth(), fb.getHeight());
+    }
+}
+
+void TileRenderer::renderTiles() {
+    TRACE_ZONE("tiles");
+    int count = tilesX * tilesY;
+    for (int tile = nextTile++; tile < count; tile = nextTile++) {
+        int tx = tile % tilesX;
+        int ty = tile / tilesX;
+        Box clip(Point(tx * TILE_SIZE, ty * TILE_SIZE), Point((tx + 1) * TILE_SIZE - 1, (ty + 1) * TILE_SIZE - 1));
+
+        target->clear(clip);
+        if (entities) {
+            drawEntities(*target, *entities, entityBins.bins[tile], clip);
+        }
+        for (int i : bins[tile]) {
+            target->draw(*(*elements)[i], clip);
+        }
+    }
+}
+
+void TileRenderer::workerLoop() {
+    Trace::setThreadName("tile worker");
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            startCv.wait(lock, [&] { return stop || frame != seen; });
+            if (stop) {
+                return;
+            }
+            seen = frame;
+        }
+
+        renderTiles();
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            last = --busyWorkers == 0;
+        }
+        if (last) {
+            doneCv.notify_one();
+        }
+    }
+}
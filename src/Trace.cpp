@@ -0,0 +1,121 @@
+#include "Trace.hpp"
+#include "Config.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent {
+    const char* name;
+    Trace::Clock::time_point start;
+    Trace::Clock::time_point end;
+};
+
+// Written only by its owning thread. count is published with release so write() sees
+// complete events without locking the writer.
+struct ThreadBuffer {
+    ThreadBuffer(int tid) : count(0), dropped(0), tid(tid), name(nullptr) {}
+
+    TraceEvent events[TRACE_EVENTS];
+    std::atomic<int> count;
+    std::atomic<int> dropped;
+    int tid;
+    const char* name;
+};
+
+// Buffers live until exit since threads may still hold them after write().
+static std::mutex registryMutex;
+static std::vector<ThreadBuffer*> registry;
+static thread_local ThreadBuffer* localBuffer = nullptr;
+
+static ThreadBuffer* getLocalBuffer() {
+    if (!localBuffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        localBuffer = new ThreadBuffer(registry.size() + 1);
+        registry.push_back(localBuffer);
+    }
+    return localBuffer;
+}
+
+static const char* getPath() {
+    static const char* path = getenv("ZAVLADI_TRACE");
+    return path;
+}
+
+bool Trace::enabled() {
+    return getPath() != nullptr;
+}
+
+void Trace::zone(const char* name, Clock::time_point start, Clock::time_point end) {
+    ThreadBuffer* buf = getLocalBuffer();
+    int n = buf->count.load(std::memory_order_relaxed);
+    if (n == TRACE_EVENTS) {
+        buf->dropped.store(buf->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& e = buf->events[n];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    buf->count.store(n + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char* name) {
+    if (enabled()) {
+        ThreadBuffer* buf = getLocalBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buf->name = name;
+    }
+}
+
+bool Trace::write() {
+    const char* path = getPath();
+    if (!path) {
+        return true;
+    }
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open trace file %s\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    Clock::time_point origin = Clock::time_point::max();
+    for (ThreadBuffer* buf : registry) {
+        if (buf->count.load(std::memory_order_acquire) > 0) {
+            origin = std::min(origin, buf->events[0].start);
+        }
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"zavladi\"}}");
+    int dropped = 0;
+    for (ThreadBuffer* buf : registry) {
+        if (buf->name) {
+            fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                buf->tid, buf->name);
+        }
+        int n = buf->count.load(std::memory_order_acquire);
+        for (int i = 0; i < n; ++i) {
+            const TraceEvent& e = buf->events[i];
+            std::chrono::duration<double, std::micro> ts = e.start - origin;
+            std::chrono::duration<double, std::micro> dur = e.end - e.start;
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                e.name, buf->tid, ts.count(), dur.count());
+        }
+        dropped += buf->dropped.load(std::memory_order_relaxed);
+    }
+    fprintf(fp, "\n]}\n");
+
+    if (dropped > 0) {
+        fprintf(stderr, "Trace buffers were full, dropped %d zones\n", dropped);
+    }
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Failed to write trace file %s\n", path);
+        return false;
+    }
+    return true;
+}
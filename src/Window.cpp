@@ -1,4 +1,8 @@
 #include "Window.hpp"
+#include "Palette.hpp"
+#include "Profiler.hpp"
+#include "SpscQueue.hpp"
+#include "Trace.hpp"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -7,7 +11,43 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Entry points newer than the 3.3 core loader, fetched at runtime when the driver has them.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum format, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static PFNGLTEXSTORAGE2DPROC texStorage2D = nullptr;
+static PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+
+struct TextureFormat {
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    int bytes;
+};
+
+TextureFormat getTextureFormat(UploadFormat format) {
+    switch (format) {
+        case format_rgb10a2:
+            return TextureFormat{ GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4 };
+        case format_palette:
+            return TextureFormat{ GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, 1 };
+        default:
+            return TextureFormat{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+    }
+}
 
 struct GraphicsContext {
     GLuint program;
@@ -15,10 +55,39 @@ struct GraphicsContext {
     GLuint vbo;
     GLuint ebo;
     GLuint tex;
-
-    GraphicsContext() : program(0), vao(0), vbo(0), ebo(0), tex(0) {}
+    GLuint paletteTex;
+    GLint sizeLoc;
+    GLint prescaleLoc;
+    // Size of the window, the largest framebuffer the texture and upload buffers hold.
+    int width;
+    int height;
+
+    UploadMode upload;
+    UploadFormat format;
+    Palette palette;
+    // Ring of pixel unpack buffers. A slot is reused only once its fence has signaled.
+    GLuint pbos[UPLOAD_BUFFERS];
+    GLsync fences[UPLOAD_BUFFERS];
+    // Persistently mapped storage of each slot, null when buffers are mapped per frame.
+    unsigned char* mapped[UPLOAD_BUFFERS];
+    int nextPbo;
+
+    GraphicsContext() :
+        program(0), vao(0), vbo(0), ebo(0), tex(0), paletteTex(0), sizeLoc(-1), prescaleLoc(-1), width(0), height(0),
+        upload(upload_pbo), format(format_rgba8), nextPbo(0) {
+        for (int i = 0; i < UPLOAD_BUFFERS; ++i) {
+            pbos[i] = 0;
+            fences[i] = 0;
+            mapped[i] = nullptr;
+        }
+    }
 
     ~GraphicsContext() {
+        for (int i = 0; i < UPLOAD_BUFFERS; ++i) {
+            glDeleteSync(fences[i]);
+        }
+        glDeleteBuffers(UPLOAD_BUFFERS, pbos);
+        glDeleteTextures(1, &paletteTex);
         glDeleteTextures(1, &tex);
         glDeleteBuffers(1, &ebo);
         glDeleteBuffers(1, &vbo);
@@ -27,13 +96,60 @@ struct GraphicsContext {
     }
 };
 
+// A finished frame on its way to the presentation thread. Only rects of fb are
+// current, the texture keeps everything outside of them from earlier frames.
+struct PresentFrame {
+    Framebuffer* fb;
+    std::vector<Box> rects;
+
+    PresentFrame() : fb(nullptr) {}
+};
+
+// Presentation thread, which owns the GL context while it runs. Frames cycle from the
+// free queue to the render thread, through the ready queue to the presentation thread
+// and back, so at most depth frames are ever waiting. The mutex only parks a thread
+// that found its queue empty.
+struct Pipeline {
+    PresentFrame frames[PIPELINE_MAX_FRAMES];
+    int depth;
+    SpscQueue<PresentFrame*, PIPELINE_MAX_FRAMES> ready;
+    SpscQueue<PresentFrame*, PIPELINE_MAX_FRAMES> free;
+    // Frames the render thread took off free while draining, which it hands out before
+    // waiting on free again. Render thread only.
+    PresentFrame* drained[PIPELINE_MAX_FRAMES];
+    int drainedCount;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<bool> stop;
+    std::thread thread;
+
+    Pipeline() : depth(0), drainedCount(0), stop(false) {}
+
+    ~Pipeline() {
+        for (PresentFrame& f : frames) {
+            delete f.fb;
+        }
+    }
+};
+
 struct WindowContext {
     Framebuffer* fb;
     GraphicsContext* objs;
-
-    WindowContext() : fb(nullptr), objs(nullptr) {}
+    Pipeline* pipeline;
+    // RGBA8 copy of fb for conversions when it is tiled or indexed.
+    std::vector<Color4b> staging;
+    // Whole frame in the upload format, for direct uploads that cannot use fb as is.
+    std::vector<unsigned char> converted;
+    // Rectangles sent to the texture this frame.
+    std::vector<Box> uploads;
+    // Set by the input and refresh callbacks until takeWindowEvents.
+    bool events;
+    bool iconified;
+
+    WindowContext() : fb(nullptr), objs(nullptr), pipeline(nullptr), events(false), iconified(false) {}
 
     ~WindowContext() {
+        delete pipeline;
         delete fb;
         delete objs;
     }
@@ -70,7 +186,7 @@ GLuint compileShader(GLenum type, const char* src) {
     return id;
 }
 
-GLuint createProgram() {
+GLuint createProgram(UploadFormat format, UpscaleFilter filter) {
     const char* vertSrc = {
         "#version 330 core\n"
         "layout (location = 0) in vec3 pos;\n"
@@ -83,23 +199,70 @@ GLuint createProgram() {
         "}\n"
     };
 
-    const char* fragSrc = {
+    // The framebuffer covers size texels of the texture, which may be larger. Texels are
+    // fetched individually so that both filters also work on the integer palette texture.
+    const char* fetchSrc = {
         "#version 330 core\n"
         "uniform sampler2D tex;\n"
+        "uniform vec2 size;\n"
+        "uniform float prescale;\n"
         "in vec2 uvs;\n"
         "out vec4 color;\n"
+        "vec4 fetch(ivec2 p)\n"
+        "{\n"
+        "   return texelFetch(tex, clamp(p, ivec2(0), ivec2(size) - 1), 0);\n"
+        "}\n"
+    };
+
+    // Expands 8-bit indices through a 256x1 palette texture on unit 1.
+    const char* paletteFetchSrc = {
+        "#version 330 core\n"
+        "uniform usampler2D tex;\n"
+        "uniform sampler2D palette;\n"
+        "uniform vec2 size;\n"
+        "uniform float prescale;\n"
+        "in vec2 uvs;\n"
+        "out vec4 color;\n"
+        "vec4 fetch(ivec2 p)\n"
+        "{\n"
+        "   uint index = texelFetch(tex, clamp(p, ivec2(0), ivec2(size) - 1), 0).r;\n"
+        "   return texelFetch(palette, ivec2(int(index), 0), 0);\n"
+        "}\n"
+    };
+
+    const char* nearestSrc = {
         "void main()\n"
         "{\n"
-        "   color = texture(tex, uvs);\n"
+        "   color = fetch(ivec2(uvs * size));\n"
         "}\n"
     };
 
+    // Sharp bilinear: every texel is drawn as a solid block prescale window pixels wide
+    // and only the one pixel wide border between two texels is interpolated.
+    const char* sharpSrc = {
+        "void main()\n"
+        "{\n"
+        "   vec2 texel = uvs * size;\n"
+        "   float range = 0.5 - 0.5 / prescale;\n"
+        "   vec2 d = fract(texel) - 0.5;\n"
+        "   vec2 p = floor(texel) + (d - clamp(d, -range, range)) * prescale;\n"
+        "   ivec2 i = ivec2(floor(p));\n"
+        "   vec2 w = p - floor(p);\n"
+        "   vec4 bottom = mix(fetch(i), fetch(i + ivec2(1, 0)), w.x);\n"
+        "   vec4 top = mix(fetch(i + ivec2(0, 1)), fetch(i + ivec2(1, 1)), w.x);\n"
+        "   color = mix(bottom, top, w.y);\n"
+        "}\n"
+    };
+
+    std::string fragSrc = format == format_palette ? paletteFetchSrc : fetchSrc;
+    fragSrc += filter == upscale_sharp ? sharpSrc : nearestSrc;
+
     GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertSrc);
     if (vertShader == 0) {
         return 0;
     }
 
-    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrc);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrc.c_str());
     if (fragShader == 0) {
         return 0;
     }
@@ -124,6 +287,12 @@ GLuint createProgram() {
 
     glDeleteShader(vertShader);
     glDeleteShader(fragShader);
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    if (format == format_palette) {
+        glUniform1i(glGetUniformLocation(program, "palette"), 1);
+    }
     return program;
 }
 
@@ -161,7 +330,23 @@ GLuint createElementObject() {
     return ebo;
 }
 
-GLuint createTextureObject() {
+bool hasGLFeature(int major, int minor, const char* extension) {
+    if (GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor)) {
+        return true;
+    }
+    return glfwExtensionSupported(extension);
+}
+
+void loadGLExtensions() {
+    if (hasGLFeature(4, 2, "GL_ARB_texture_storage")) {
+        texStorage2D = (PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
+    }
+    if (hasGLFeature(4, 4, "GL_ARB_buffer_storage")) {
+        bufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+    }
+}
+
+GLuint createTextureObject(int width, int height, bool immutable, const TextureFormat& fmt) {
     GLuint tex;
     glGenTextures(1, &tex);
     glBindTexture(GL_TEXTURE_2D, tex);
@@ -169,29 +354,80 @@ GLuint createTextureObject() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (immutable && texStorage2D) {
+        texStorage2D(GL_TEXTURE_2D, 1, fmt.internalFormat, width, height);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, fmt.internalFormat, width, height, 0, fmt.format, fmt.type, NULL);
+    }
+    return tex;
+}
+
+GLuint createPaletteTexture() {
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     return tex;
 }
 
-GraphicsContext* createGraphicsContext() {
+bool createUploadBuffers(GraphicsContext* ctx, int width, int height) {
+    GLsizeiptr size = (GLsizeiptr)width * height * getTextureFormat(ctx->format).bytes;
+    glGenBuffers(UPLOAD_BUFFERS, ctx->pbos);
+    for (int i = 0; i < UPLOAD_BUFFERS; ++i) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ctx->pbos[i]);
+        if (bufferStorage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+            ctx->mapped[i] = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+            if (!ctx->mapped[i]) {
+                logError("Failed to map upload buffer %d\n", i);
+                return false;
+            }
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+GraphicsContext* createGraphicsContext(int width, int height, const Options& opts) {
     GraphicsContext* ctx = new(std::nothrow) GraphicsContext;
     if (!ctx) {
         return nullptr;
     }
+    ctx->upload = opts.upload;
+    ctx->format = opts.format;
 
-    GLuint program = createProgram();
+    GLuint program = createProgram(opts.format, opts.upscale);
     if (program == 0) {
         delete ctx;
         return nullptr;
     }
     ctx->program = program;
+    ctx->sizeLoc = glGetUniformLocation(program, "size");
+    ctx->prescaleLoc = glGetUniformLocation(program, "prescale");
+    ctx->width = width;
+    ctx->height = height;
 
     glGenVertexArrays(1, &ctx->vao);
     glBindVertexArray(ctx->vao);
 
     ctx->vbo = createBufferObject();
     ctx->ebo = createElementObject();
-    ctx->tex = createTextureObject();
-    
+    if (opts.format == format_palette) {
+        ctx->paletteTex = createPaletteTexture();
+        ctx->palette.build();
+    }
+    // Direct uploads respecify the texture every frame, which immutable storage forbids.
+    bool direct = opts.upload == upload_direct;
+    ctx->tex = createTextureObject(width, height, !direct, getTextureFormat(opts.format));
+    if (!direct && !createUploadBuffers(ctx, width, height)) {
+        delete ctx;
+        return nullptr;
+    }
 
     return ctx;
 }
@@ -200,17 +436,73 @@ void destroyWindow(GLFWwindow* window) {
     void* user = glfwGetWindowUserPointer(window);
     if (user) {
         WindowContext* wctx = reinterpret_cast<WindowContext*>(user);
+        Pipeline* p = wctx->pipeline;
+        if (p) {
+            {
+                std::lock_guard<std::mutex> lock(p->mtx);
+                p->stop = true;
+            }
+            p->cv.notify_all();
+            p->thread.join();
+            // The GL objects are deleted on this thread.
+            glfwMakeContextCurrent(window);
+        }
         delete wctx;
     }
     glfwDestroyWindow(window);
     glfwTerminate();
 }
 
+// Adaptive vsync (swap interval -1) tears instead of waiting a whole extra refresh when
+// a frame misses vblank.
+void setSwapInterval(PacingMode pacing) {
+    switch (pacing) {
+        case pacing_adaptive:
+            if (glfwExtensionSupported("GLX_EXT_swap_control_tear") || glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+                glfwSwapInterval(-1);
+                break;
+            }
+            logError("Adaptive vsync is not supported, using vsync\n");
+            glfwSwapInterval(1);
+            break;
+        case pacing_vsync:
+            glfwSwapInterval(1);
+            break;
+        default:
+            glfwSwapInterval(0);
+            break;
+    }
+}
+
 void errorCallback(int code, const char* s) {
     logError("GLFW cb error[code=%d]: %s\n", code, s);
 }
 
-GLFWwindow* createWindow(int width, int height) {
+void keyCallback(GLFWwindow* window, int, int, int, int) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (user) {
+        reinterpret_cast<WindowContext*>(user)->events = true;
+    }
+}
+
+void refreshCallback(GLFWwindow* window) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (user) {
+        reinterpret_cast<WindowContext*>(user)->events = true;
+    }
+}
+
+void iconifyCallback(GLFWwindow* window, int iconified) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (user) {
+        WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
+        ctx->iconified = iconified;
+        // The contents are lost while minimized on some platforms.
+        ctx->events = true;
+    }
+}
+
+GLFWwindow* createWindow(int width, int height, const Options& opts) {
     if (!glfwInit()) {
         logError("Failed to init GLFW\n");
         return nullptr;
@@ -230,13 +522,14 @@ GLFWwindow* createWindow(int width, int height) {
     }
     glfwSetWindowAttrib(window, GLFW_RESIZABLE, GLFW_FALSE);
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    setSwapInterval(opts.pacing);
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         logError("Could not load opengl library\n");
         destroyWindow(window);
         return nullptr;
     }
     glViewport(0, 0, width, height);
+    loadGLExtensions();
 
     WindowContext* wctx = new(std::nothrow) WindowContext;
     if (!wctx) {
@@ -254,7 +547,7 @@ GLFWwindow* createWindow(int width, int height) {
     }
     wctx->fb = fb;
 
-    GraphicsContext* objs = createGraphicsContext();
+    GraphicsContext* objs = createGraphicsContext(width, height, opts);
     if (!objs) {
         logError("Failed to initialize graphics context\n");
         destroyWindow(window);
@@ -262,6 +555,9 @@ GLFWwindow* createWindow(int width, int height) {
     }
     wctx->objs = objs;
 
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, refreshCallback);
+    glfwSetWindowIconifyCallback(window, iconifyCallback);
     return window;
 }
 
@@ -274,19 +570,387 @@ Framebuffer* getWindowFramebuffer(GLFWwindow* window) {
     return nullptr;
 }
 
+uint32_t packRGB10A2(Color4b c) {
+    // Replicate the top bits so 255 maps to 1023.
+    uint32_t r = c.r << 2 | c.r >> 6;
+    uint32_t g = c.g << 2 | c.g >> 6;
+    uint32_t b = c.b << 2 | c.b >> 6;
+    return r | g << 10 | b << 20 | (uint32_t)(c.a >> 6) << 30;
+}
+
+// Writes rect of fb into dst, an image of the whole frame in the upload format.
+void convertRect(WindowContext* ctx, const Framebuffer* fb, unsigned char* dst, const Box& rect) {
+    GraphicsContext* objs = ctx->objs;
+    int width = fb->getWidth();
+    if (objs->format == format_palette && Framebuffer::indexed) {
+        fb->readPixels((FramebufferPixel*)dst, rect);
+        return;
+    }
+    if (objs->format == format_rgba8) {
+        fb->readColors((Color4b*)dst, rect);
+        return;
+    }
+
+    const Color4b* src;
+    if (Framebuffer::linear && !Framebuffer::indexed) {
+        src = reinterpret_cast<const Color4b*>(fb->getData());
+    } else {
+        ctx->staging.resize(width * fb->getHeight());
+        fb->readColors(ctx->staging.data(), rect);
+        src = ctx->staging.data();
+    }
+    int count = rect.width() + 1;
+    for (int y = rect.ymin(); y <= rect.ymax(); ++y) {
+        size_t offset = (size_t)y * width + rect.xmin();
+        if (objs->format == format_palette) {
+            objs->palette.quantize(src + offset, dst + offset, count);
+        } else {
+            uint32_t* row = (uint32_t*)dst + offset;
+            for (int x = 0; x < count; ++x) {
+                row[x] = packRGB10A2(src[offset + x]);
+            }
+        }
+    }
+}
+
+// Respecifies the whole texture from client memory, stalling until the driver has copied it.
+void uploadDirect(WindowContext* ctx, const Framebuffer* fb) {
+    GraphicsContext* objs = ctx->objs;
+    TextureFormat fmt = getTextureFormat(objs->format);
+    const void* pixels = fb->getData();
+    if (objs->format != format_rgba8 || !Framebuffer::linear || Framebuffer::indexed) {
+        ctx->converted.resize((size_t)fb->getWidth() * fb->getHeight() * fmt.bytes);
+        convertRect(ctx, fb, ctx->converted.data(), fb->getBounds());
+        pixels = ctx->converted.data();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, objs->tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, fmt.internalFormat, fb->getWidth(), fb->getHeight(), 0, fmt.format, fmt.type, pixels);
+}
+
+long pixelCount(const Box& r) {
+    return (long)(r.width() + 1) * (r.height() + 1);
+}
+
+// Turns the dirty rects into the rects to upload. Each glTexSubImage2D call costs about
+// UPLOAD_RECT_COST pixels of bandwidth, so two rects are sent as their union when that
+// adds fewer pixels than the call it saves. Past UPLOAD_FULL_RATIO of the screen the
+// whole frame goes up in one call.
+void planUploads(const std::vector<Box>& dirty, const Box& bounds, std::vector<Box>& rects) {
+    rects.assign(dirty.begin(), dirty.end());
+    for (bool merged = true; merged;) {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < rects.size() && !merged; ++j) {
+                Box u = rects[i].unite(rects[j]);
+                long extra = pixelCount(u) - pixelCount(rects[i]) - pixelCount(rects[j]);
+                if (extra < UPLOAD_RECT_COST) {
+                    rects[i] = u;
+                    rects[j] = rects.back();
+                    rects.pop_back();
+                    merged = true;
+                }
+            }
+        }
+    }
+
+    long area = 0;
+    for (const Box& r : rects) {
+        area += pixelCount(r);
+    }
+    if (area > UPLOAD_FULL_RATIO * pixelCount(bounds)) {
+        rects.assign(1, bounds);
+    }
+}
+
+// The rects of fb that go to the texture this frame.
+void planFrame(const Framebuffer* fb, UploadMode upload, std::vector<Box>& rects) {
+    if (upload == upload_direct) {
+        rects.assign(1, fb->getBounds());
+    } else {
+        planUploads(fb->getDirty(), fb->getBounds(), rects);
+    }
+}
+
+// Copies rects into the next buffer of the ring and lets the driver pull them into the
+// texture asynchronously. The framebuffer stays in client memory because retained
+// rendering repaints only dirty rects on top of the previous frame, which a ring slot
+// last written UPLOAD_BUFFERS frames ago does not hold.
+void uploadBuffered(WindowContext* ctx, const Framebuffer* fb, const std::vector<Box>& rects) {
+    GraphicsContext* objs = ctx->objs;
+    if (rects.empty()) {
+        return;
+    }
+    int slot = objs->nextPbo;
+    objs->nextPbo = (slot + 1) % UPLOAD_BUFFERS;
+
+    if (objs->fences[slot]) {
+        TRACE_ZONE("fence wait");
+        GLenum s;
+        do {
+            s = glClientWaitSync(objs->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (s == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(objs->fences[slot]);
+        objs->fences[slot] = 0;
+    }
+
+    // Rects keep their position in the buffer, which has the layout of the whole frame.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, objs->pbos[slot]);
+    TextureFormat fmt = getTextureFormat(objs->format);
+    if (objs->mapped[slot]) {
+        for (const Box& r : rects) {
+            convertRect(ctx, fb, objs->mapped[slot], r);
+        }
+    } else {
+        // The fence already guarantees the GPU is done with this slot.
+        GLsizeiptr size = (GLsizeiptr)fb->getWidth() * fb->getHeight() * fmt.bytes;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        for (size_t i = 0; dst && i < rects.size(); ++i) {
+            convertRect(ctx, fb, dst, rects[i]);
+        }
+        if (!dst || !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+            logError("Lost upload buffer contents\n");
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, objs->tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, fb->getWidth());
+    for (const Box& r : rects) {
+        size_t offset = ((size_t)r.ymin() * fb->getWidth() + r.xmin()) * fmt.bytes;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r.xmin(), r.ymin(), r.width() + 1, r.height() + 1, fmt.format, fmt.type,
+            (const void*)offset);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    objs->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void uploadFrame(WindowContext* ctx, const Framebuffer* fb, const std::vector<Box>& rects) {
+    if (ctx->objs->upload == upload_direct) {
+        uploadDirect(ctx, fb);
+    } else {
+        uploadBuffered(ctx, fb, rects);
+    }
+}
+
+void drawFrame(GraphicsContext* objs, int width, int height) {
+    TRACE_ZONE("draw");
+    if (objs->paletteTex) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, objs->paletteTex);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glUseProgram(objs->program);
+    glUniform2f(objs->sizeLoc, width, height);
+    glUniform1f(objs->prescaleLoc, (float)objs->width / width);
+    glBindVertexArray(objs->vao);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+}
+
+// Takes a frame off q, parking until one arrives. Returns null once the pipeline
+// stops and q is drained.
+PresentFrame* waitFrame(Pipeline* p, SpscQueue<PresentFrame*, PIPELINE_MAX_FRAMES>& q) {
+    PresentFrame* frame;
+    while (!q.pop(frame)) {
+        std::unique_lock<std::mutex> lock(p->mtx);
+        p->cv.wait(lock, [&] { return !q.empty() || p->stop; });
+        if (q.empty()) {
+            return nullptr;
+        }
+    }
+    return frame;
+}
+
+void sendFrame(Pipeline* p, SpscQueue<PresentFrame*, PIPELINE_MAX_FRAMES>& q, PresentFrame* frame) {
+    q.push(frame);
+    {
+        // Orders the push before a waiter's check of the queue.
+        std::lock_guard<std::mutex> lock(p->mtx);
+    }
+    p->cv.notify_all();
+}
+
+// Body of the presentation thread. A frame goes back to the render thread as soon as
+// its pixels are in the upload buffers, before the draw and the swap.
+void presentLoop(GLFWwindow* window, WindowContext* ctx) {
+    Trace::setThreadName("present");
+    glfwMakeContextCurrent(window);
+    Pipeline* p = ctx->pipeline;
+    while (PresentFrame* frame = waitFrame(p, p->ready)) {
+        int width = frame->fb->getWidth();
+        int height = frame->fb->getHeight();
+        {
+            TRACE_ZONE("upload");
+            uploadFrame(ctx, frame->fb, frame->rects);
+        }
+        sendFrame(p, p->free, frame);
+        drawFrame(ctx->objs, width, height);
+        TRACE_ZONE("swap");
+        glfwSwapBuffers(window);
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+// Copies what changed into a free frame and queues it for presentation.
+void submitFrame(WindowContext* ctx, PresentFrame* frame) {
+    Pipeline* p = ctx->pipeline;
+    planFrame(ctx->fb, ctx->objs->upload, frame->rects);
+    frame->fb->setPalette(ctx->fb->getPalette());
+    for (const Box& r : frame->rects) {
+        frame->fb->copy(*ctx->fb, r);
+    }
+    sendFrame(p, p->ready, frame);
+}
+
+// Waits until the presentation thread has handed back every frame. The render thread
+// keeps them, since only the presentation thread may push to free.
+void drainPipeline(Pipeline* p) {
+    while (p->drainedCount < p->depth) {
+        p->drained[p->drainedCount++] = waitFrame(p, p->free);
+    }
+}
+
+// Next frame for the render thread to fill.
+PresentFrame* takeFrame(Pipeline* p) {
+    if (p->drainedCount > 0) {
+        return p->drained[--p->drainedCount];
+    }
+    return waitFrame(p, p->free);
+}
+
 void displayWindowFramebuffer(GLFWwindow* window) {
+    TRACE_ZONE("display");
+    void* user = glfwGetWindowUserPointer(window);
+    if (user) {
+        WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
+        if (ctx->pipeline) {
+            // With every frame in flight the render thread waits for presentation, just
+            // like it would in the swap.
+            PresentFrame* frame;
+            {
+                PROFILE_SCOPE(phase_swap);
+                frame = takeFrame(ctx->pipeline);
+            }
+            PROFILE_SCOPE(phase_upload);
+            submitFrame(ctx, frame);
+            return;
+        }
+
+        {
+            PROFILE_SCOPE(phase_upload);
+            planFrame(ctx->fb, ctx->objs->upload, ctx->uploads);
+            uploadFrame(ctx, ctx->fb, ctx->uploads);
+        }
+        drawFrame(ctx->objs, ctx->fb->getWidth(), ctx->fb->getHeight());
+        PROFILE_SCOPE(phase_swap);
+        glfwSwapBuffers(window);
+    }
+}
+
+bool startWindowPipeline(GLFWwindow* window, int depth) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (!user) {
+        return false;
+    }
+    WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
+    Pipeline* p = new(std::nothrow) Pipeline;
+    if (!p) {
+        logError("Failed to create presentation pipeline\n");
+        return false;
+    }
+    p->depth = std::min(depth, PIPELINE_MAX_FRAMES);
+    for (int i = 0; i < p->depth; ++i) {
+        p->frames[i].fb = new(std::nothrow) Framebuffer(ctx->fb->getWidth(), ctx->fb->getHeight());
+        if (!p->frames[i].fb) {
+            logError("Failed to create pipeline framebuffer\n");
+            delete p;
+            return false;
+        }
+        p->free.push(&p->frames[i]);
+    }
+    ctx->pipeline = p;
+    glfwMakeContextCurrent(nullptr);
+    p->thread = std::thread(presentLoop, window, ctx);
+    return true;
+}
+
+Framebuffer* resizeWindowFramebuffer(GLFWwindow* window, int width, int height) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (!user) {
+        return nullptr;
+    }
+    WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
+    width = std::min(width, ctx->objs->width);
+    height = std::min(height, ctx->objs->height);
+    if (width == ctx->fb->getWidth() && height == ctx->fb->getHeight()) {
+        return ctx->fb;
+    }
+    Framebuffer* fb = new(std::nothrow) Framebuffer(width, height);
+    if (!fb) {
+        logError("Failed to resize framebuffer (w=%d h=%d)\n", width, height);
+        return nullptr;
+    }
+    delete ctx->fb;
+    ctx->fb = fb;
+
+    Pipeline* p = ctx->pipeline;
+    if (p) {
+        drainPipeline(p);
+        for (int i = 0; i < p->depth; ++i) {
+            delete p->frames[i].fb;
+            p->frames[i].fb = new(std::nothrow) Framebuffer(width, height);
+            if (!p->frames[i].fb) {
+                logError("Failed to resize pipeline framebuffer\n");
+                return nullptr;
+            }
+        }
+    }
+    return fb;
+}
+
+void drainWindowPipeline(GLFWwindow* window) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (user) {
+        WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
+        if (ctx->pipeline) {
+            drainPipeline(ctx->pipeline);
+        }
+    }
+}
+
+void setWindowPalette(GLFWwindow* window, const Palette& palette) {
     void* user = glfwGetWindowUserPointer(window);
     if (user) {
         WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
-        Framebuffer* fb = ctx->fb;
         GraphicsContext* objs = ctx->objs;
+        objs->palette = palette;
+        if (objs->paletteTex) {
+            glBindTexture(GL_TEXTURE_2D, objs->paletteTex);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, objs->palette.colors);
+        }
+        // Everything uploaded so far used the previous palette.
+        ctx->fb->addDirty(ctx->fb->getBounds());
+    }
+}
 
-        glBindTexture(GL_TEXTURE_2D, objs->tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, fb->getWidth(), fb->getHeight(), 0, GL_RGB, GL_FLOAT, fb->getData());
-        glUseProgram(objs->program);
-        glBindVertexArray(objs->vao);
+bool isWindowHidden(GLFWwindow* window) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (user && reinterpret_cast<WindowContext*>(user)->iconified) {
+        return true;
+    }
+    return !glfwGetWindowAttrib(window, GLFW_VISIBLE);
+}
 
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
-        glfwSwapBuffers(window);
+bool takeWindowEvents(GLFWwindow* window) {
+    void* user = glfwGetWindowUserPointer(window);
+    if (user) {
+        WindowContext* ctx = reinterpret_cast<WindowContext*>(user);
+        bool events = ctx->events;
+        ctx->events = false;
+        return events;
     }
+    return false;
 }
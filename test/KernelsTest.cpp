@@ -0,0 +1,89 @@
+#include "Kernels.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Checks every kernel variant against the scalar reference, for every length up to
+// MAX_COUNT at every start offset within a 64 byte line. The destination is compared
+// as a whole, so writes past the end show up as well.
+const int MAX_COUNT = 70;
+const int MAX_OFFSET = 16;
+const int BUFFER = MAX_OFFSET + 4 * (MAX_COUNT + 8);
+
+static int failures = 0;
+
+static void check(bool ok, const char* variant, const char* kernel, int count, int offset) {
+    if (!ok) {
+        fprintf(stderr, "%s/%s differs from scalar (count=%d offset=%d)\n", variant, kernel, count, offset);
+        ++failures;
+    }
+}
+
+static bool same(const std::vector<Color4b>& a, const std::vector<Color4b>& b) {
+    return memcmp(a.data(), b.data(), a.size() * sizeof(Color4b)) == 0;
+}
+
+static void testVariant(const Kernels& k, const Kernels& ref) {
+    std::vector<Color4b> init(BUFFER);
+    std::vector<Color4b> src(BUFFER);
+    std::vector<uint8_t> bytes(BUFFER);
+    std::vector<Color4b> palette(256);
+    for (int i = 0; i < BUFFER; ++i) {
+        init[i] = Color4b(i, i * 3, i * 7, i * 11);
+        src[i] = Color4b(255 - i, i * 5, i * 13, 255);
+        // Mixes masked and unmasked pixels in irregular runs, and covers every index.
+        bytes[i] = (i * 37 + i / 5) % 3 ? (uint8_t)(i * 29) : 0;
+    }
+    for (int i = 0; i < 256; ++i) {
+        palette[i] = Color4b(i, 255 - i, i * 2, i * 3);
+    }
+    Color4b col(12, 34, 56, 78);
+
+    for (int count = 0; count <= MAX_COUNT; ++count) {
+        for (int offset = 0; offset < MAX_OFFSET; ++offset) {
+            std::vector<Color4b> a = init;
+            std::vector<Color4b> b = init;
+            k.fillSpan(&a[offset], count, col);
+            ref.fillSpan(&b[offset], count, col);
+            check(same(a, b), k.name, "fillSpan", count, offset);
+
+            // Three rows with a stride that is not a multiple of the vector width.
+            int stride = count + 3;
+            a = init;
+            b = init;
+            k.fillRect(&a[offset], stride, count, 3, col);
+            ref.fillRect(&b[offset], stride, count, 3, col);
+            check(same(a, b), k.name, "fillRect", count, offset);
+
+            a = init;
+            b = init;
+            k.maskedBlit(&a[offset], &src[MAX_OFFSET - offset], &bytes[offset], count);
+            ref.maskedBlit(&b[offset], &src[MAX_OFFSET - offset], &bytes[offset], count);
+            check(same(a, b), k.name, "maskedBlit", count, offset);
+
+            a = init;
+            b = init;
+            k.expandIndices(&a[offset], &bytes[MAX_OFFSET - offset], palette.data(), count);
+            ref.expandIndices(&b[offset], &bytes[MAX_OFFSET - offset], palette.data(), count);
+            check(same(a, b), k.name, "expandIndices", count, offset);
+        }
+    }
+}
+
+int main() {
+    const Kernels* ref = scalarKernels();
+    const Kernels* variants[] = { sse2Kernels(), avx2Kernels(), avx512Kernels() };
+    for (const Kernels* k : variants) {
+        if (!k) {
+            continue;
+        }
+        testVariant(*k, *ref);
+        printf("%s: checked\n", k->name);
+    }
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}